@@ -0,0 +1,36 @@
+#############################
+# crtsurfdata生成速度的压力测试脚本 #
+#############################
+
+# 用法：./benchsurfdata.sh [站点数列表] [格式列表]
+# 例如：./benchsurfdata.sh "1000 100000 10000000" "csv xml json bin"
+# 每种格式、每个站点数单独运行一次crtsurfdata，输出记录/秒、字节/秒和内存峰值（KB）。
+
+STATIONS=${1:-"1000 10000 100000 1000000"}
+FORMATS=${2:-"csv xml json bin"}
+
+BINDIR=$(cd $(dirname $0) && pwd)
+INIFILE=$BINDIR/../ini/stcode.ini
+OUTPATH=/tmp/idc/benchsurfdata
+LOGFILE=/tmp/idc/benchsurfdata.log
+
+printf "%-6s %10s %12s %14s %10s\n" format stations records/s bytes/s maxrss_kb
+
+for fmt in $FORMATS
+do
+  for n in $STATIONS
+  do
+    rm -rf $OUTPATH $LOGFILE
+    $BINDIR/crtsurfdata $INIFILE $OUTPATH $LOGFILE $fmt now 1 $n
+
+    # 日志中的统计行：统计：格式csv，站点数1000，记录数1000，字节数56000，耗时0.003秒，记录/秒333333，字节/秒18666666，内存峰值4000KB
+    grep "统计：" $LOGFILE | tail -1 | \
+      sed 's/.*记录\/秒\([0-9]*\)，字节\/秒\([0-9]*\)，内存峰值\([0-9]*\)KB.*/\1 \2 \3/' | \
+      while read rps bps rss
+      do
+        printf "%-6s %10s %12s %14s %10s\n" $fmt $n $rps $bps $rss
+      done
+  done
+done
+
+rm -rf $OUTPATH $LOGFILE
@@ -5,14 +5,25 @@
  *        2. 增加信号处理函数，处理信号2和信号15
  *        3. 解决调用exit()函数退出时局部对象没有执行析构函数的问题
  *        4. 把心跳信息写入共享内存
+ *        5. 增加按时间范围回补历史数据的功能，多个时间点分配给线程池并行生成
+ *        6. 增加把站点扩充到指定数量的功能，并在结束时统计生成的速度和内存的峰值，用于压力测试
+ *        7. 随机数改用可设置种子的CRandom，按站点范围多线程生成观测数据，相同的种子生成的数据相同
+ *        8. 增加常驻内存的运行方式，每分钟整点生成一次数据，站点参数文件修改后才重新加载
+ *        9. 数据文件格式后加".gz"时直接生成gzip压缩的数据文件，不需要再用gzipfiles压缩
+ *        10. 增加db输出方式，观测数据直接批量插入MySQL的T_ZHOBTMIND表，每个时间点提交一次事务，
+ *            编译时定义WITH_MYSQL才支持（make crtsurfdata_db），缺省编译不依赖MySQL
  * @author Sugar (hzzou@dhu.edu.cn)
  * @date 2022-08-28
  */
 
 #include "_public.h"
+#include "_surfdata.h"
+#include "_csvrecord.h"
+#ifdef WITH_MYSQL
+#include "_mysql.h"
+#endif
 
 CLogFile logFile(10);
-char strDateTime[21];   // 观测数据的时间
 CFile file;             // file定义为全局变量（因为exit函数不会执行局部变量的析构函数）
 CPActive PActive;       // 进程心跳
 
@@ -35,52 +46,167 @@ struct st_stcode {
     double height;      // 海拔高度
 };
 
-// 全国气象站点分钟观测数据结构
-struct st_surfdata {
-    char obtid[11];     // 站点代码
-    char dateTime[21];  // 数据时间，格式-yyyymmddhh24miss
-    int t;              // 气温：单位0.1摄氏度
-    int p;              // 气压：单位0.1百帕
-    int u;              // 相对湿度：0-100之间的值，本质就是百分比
-    int wd;             // 风向：0-360之间的值，单位度
-    int wf;             // 风速：单位0.1m/s
-    int r;              // 降雨量：单位0.1mm
-    int vis;            // 能见度：单位0.1m
-};
+// 站点参数文件中每行的字段与st_stcode结构体的绑定，字段的顺序与文件中列的顺序相同
+constexpr CCSVRecord stcodeRecord(CSVField("provName", &st_stcode::provName),
+                                  CSVField("obtid", &st_stcode::obtid),
+                                  CSVField("obtName", &st_stcode::obtName),
+                                  CSVField("lat", &st_stcode::lat),
+                                  CSVField("lon", &st_stcode::lon),
+                                  CSVField("height", &st_stcode::height));
 
 // 存放全国气象站点参数的容器
 vector<struct st_stcode> vstcode;
 
-// 存放全国气象站点分钟观测数据的容器
-vector<struct st_surfdata> vsurfdata;
-
-// 把站点参数文件中的信息加载到容器中
+// 把站点参数文件中的信息加载到容器中，加载失败时容器中原来的内容不变
 bool loadSTCode(const char* iniFile);
 
-// 模拟生成观测数据存入vsurfdata容器
-void creatSurfData();
+// 把vstcode中的站点扩充（或截取）到stations个，扩充的虚拟站点以已有站点为模板，
+// 站点代码为"V"加9位序号，经纬度在模板站点附近随机偏移
+void expandSTCode(int stations);
+
+// 生成数据的统计信息，多个线程共享，用原子操作累加
+long statRecords = 0;   // 生成的记录数
+long statBytes = 0;     // 生成的数据文件的总字节数
+
+// 随机数的种子，每个站点每个时间点的随机数序列由种子、数据时间和站点序号决定，与线程数无关
+uint64_t randSeed = 0;
+
+// 模拟生成dateTime时间点的观测数据存入vsurfdata容器
+// vsurfdata采用紧凑格式，与vstcode一一对应，站点代码从vstcode中取，数据时间由全部记录共用，都不存放在记录中
+// threads：线程数，把站点按范围分给多个线程生成
+void creatSurfData(const char* dateTime, vector<struct st_surfcompact>& vsurfdata, int threads = 1);
+
+// 生成观测数据的任务，每个线程生成vsurfdata中[begin,end)范围内的记录
+struct st_filltask {
+    const char* dateTime;                   // 数据时间
+    vector<struct st_surfcompact>* vsurfdata;  // 存放观测数据的容器，已分配好空间
+    int begin;                              // 起始的站点序号
+    int end;                                // 结束的站点序号（不包括）
+};
+
+// 生成观测数据的函数，也是线程主函数，arg是st_filltask结构体的地址
+void* fillSurfData(void* arg);
+
+// 数据文件格式的描述，行存格式用CStrBuilder按格式生成记录，列存格式用writeColumns一次写入，打开文件时选定
+struct st_surffmt {
+    const char* datafmt;                                       // 文件格式，也是文件名的后缀
+    int builderfmt;                                            // 行存格式在CStrBuilder中的格式，列存格式为0
+    const char* head;                                          // 文件头
+    const char* tail;                                          // 文件尾
+    bool (*writeColumns)(CFile& file, const char* dateTime, const vector<struct st_surfcompact>& vsurfdata);  // 列存格式一次写入全部记录，行存格式为空
+};
+
+#define SURFFLUSHSIZE (64 * 1024)   // 行存格式的记录在CStrBuilder中累积到64K后写入文件
 
 // 把容器vsurfdata中的所有全国气象观测数据写入文件
-bool creatSurfFile(const char* outpath, const char* datafmt);
+// datafmt：数据文件的格式，支持xml,json,csv,bin，多个格式之间用逗号分隔，行存格式只遍历一次vsurfdata，
+//          如果有db，还会把观测数据插入数据库
+// dateTime：观测数据的时间，格式yyyymmddhh24miss
+// 返回值：true-全部格式都生成成功；false-有格式生成失败，失败的格式不影响其它格式的生成，原因已写入日志
+bool creatSurfFile(const char* outpath, const char* datafmt, const char* dateTime, const vector<struct st_surfcompact>& vsurfdata);
+
+// 判断datafmt中是否有fmt格式，datafmt中的格式用逗号分隔，逐个完整比较，不按子串匹配
+// bGzip：不为空时，fmt后加".gz"也算有该格式，用于返回是否生成gzip压缩的数据文件
+bool hasDataFmt(const char* datafmt, const char* fmt, bool* bGzip = nullptr);
+
+#ifdef WITH_MYSQL
+// 以下是db输出方式用到的变量和函数
+// 每条insert语句插入的记录数，每条记录9个字段，受绑定变量个数MAXPARAMS的限制
+#define SURFDB_BATCH (MAXPARAMS / 9)
+
+connection conn;                                    // 数据库连接
+sqlstatement stmtBatch;                             // 一次插入SURFDB_BATCH条记录的insert语句
+sqlstatement stmtRest;                              // 插入不足一批的剩余记录的insert语句，按剩余的记录数准备
+int restRows = 0;                                   // stmtRest已准备的记录数，站点数不变时只准备一次
+struct st_surfdata dbRows[SURFDB_BATCH];            // 与insert语句绑定的记录，由紧凑格式转换而来
+pthread_mutex_t dbMutex = PTHREAD_MUTEX_INITIALIZER;  // 回补历史数据时多个线程共用一个连接，插入时加锁
+
+// 连接数据库，并准备insert语句，connstr的格式与connection::connecttodb方法相同
+bool connectSurfDB(const char* connstr);
+
+// 把容器vsurfdata中的观测数据批量插入T_ZHOBTMIND表，全部插入成功后提交一次事务，失败则回滚
+bool insertSurfDB(const char* dateTime, const vector<struct st_surfcompact>& vsurfdata);
+#endif
+
+// 回补历史数据的任务，多个线程共享，每个线程每次领取一个时间点
+struct st_backfill {
+    const char* outpath;        // 数据文件存放的目录
+    const char* datafmt;        // 数据文件的格式
+    vector<string> vdateTime;   // 需要生成的全部时间点
+    int next;                   // 下一个待领取的时间点在vdateTime中的位置
+    vector<string> vfailed;     // 生成失败的时间点，全部完成后写入日志
+    pthread_mutex_t mutex;      // 领取时间点和记录失败的时间点时加锁
+};
+
+// 回补历史数据的线程主函数，arg是st_backfill结构体的地址
+void* backfillThread(void* arg);
+
+// 常驻内存运行，每分钟整点生成一次数据，直到收到退出信号
+// iniFile：站点参数文件，文件的修改时间变化后重新加载
+// stations：站点扩充的数量，0-不扩充
+void runDaemon(const char* iniFile, const char* outpath, const char* datafmt, int threads, int stations);
+
+// 按时间范围回补历史数据
+// range：时间范围，格式begintime,endtime[,step]，step是时间间隔，单位：秒，缺省60
+// threads：线程数
+bool backfill(const char* outpath, const char* datafmt, const char* range, int threads);
 
 int main(int argc, char* argv[]) {
     // inifile: 全国气象站点参数文件
     // outpath: 生成的测试数据存放目录
     // logfile: 生成的日志
-    if ((argc != 5) && (argc != 6)) {
-        printf("Using: ./crtsurfdata inifile outpath logfile [datetime]\n");
+    if ((argc < 5) || (argc > 10)) {
+        printf("Using: ./crtsurfdata inifile outpath logfile datafmt [datetime|begintime,endtime[,step] [threads [stations [seed [connstr]]]]]\n");
         printf(
             "Example:/home/sugar/project/DataCenter/idc/bin/crtsurfdata "
             "/home/sugar/project/DataCenter/idc/ini/stcode.ini "
             "/home/sugar/project/DataCenter/tmp/surfdata " 
             "/home/sugar/project/DataCenter/log/idc/crtsurfdata.log "
             "xml,json,csv "
-            "20220903013455\n\n");
+            "20220903013455\n");
+        printf(
+            "        /home/sugar/project/DataCenter/idc/bin/crtsurfdata "
+            "/home/sugar/project/DataCenter/idc/ini/stcode.ini "
+            "/home/sugar/project/DataCenter/tmp/surfdata " 
+            "/home/sugar/project/DataCenter/log/idc/crtsurfdata.log "
+            "xml,json,csv "
+            "20220901000000,20220907235900,60 8\n");
+        printf(
+            "        /home/sugar/project/DataCenter/idc/bin/crtsurfdata "
+            "/home/sugar/project/DataCenter/idc/ini/stcode.ini "
+            "/home/sugar/project/DataCenter/tmp/surfdata " 
+            "/home/sugar/project/DataCenter/log/idc/crtsurfdata.log "
+            "csv "
+            "now 8 1000000 12345\n");
+        printf(
+            "        /home/sugar/project/DataCenter/idc/bin/crtsurfdata "
+            "/home/sugar/project/DataCenter/idc/ini/stcode.ini "
+            "/home/sugar/project/DataCenter/tmp/surfdata " 
+            "/home/sugar/project/DataCenter/log/idc/crtsurfdata.log "
+            "xml,json,csv.gz "
+            "daemon\n");
+        printf(
+            "        /home/sugar/project/DataCenter/idc/bin/crtsurfdata_db "
+            "/home/sugar/project/DataCenter/idc/ini/stcode.ini "
+            "/home/sugar/project/DataCenter/tmp/surfdata " 
+            "/home/sugar/project/DataCenter/log/idc/crtsurfdata.log "
+            "db "
+            "daemon 8 0 now \"127.0.0.1,root,mysqlpwd,mysql,3306\"\n\n");
 
         printf("inifile 全国气象站点参数文件名。\n");
         printf("outpath 全国气象站点数据文件存放的目录。\n");
         printf("logfile 本程序运行的日志文件名。\n");
-        printf("datafmt 生成数据文件的格式，支持xml,json,csv三种格式，中间用逗号分隔\n\n");
+        printf("datafmt 生成数据文件的格式，支持xml,json,csv,bin四种格式，中间用逗号分隔，bin是二进制列存格式，"
+               "格式后加\".gz\"表示生成gzip压缩的数据文件，例如csv.gz；"
+               "填db表示把观测数据直接插入数据库的T_ZHOBTMIND表，可以与文件格式同时使用，"
+               "db需要用make crtsurfdata_db编译的crtsurfdata_db程序。\n");
+        printf("datetime 数据时间，格式yyyymmddhh24miss，缺省或填now取当前时间；"
+               "填daemon表示常驻内存运行，每分钟生成一次数据，不需要由procctl调度。\n");
+        printf("begintime,endtime,step 回补历史数据的时间范围，包括begintime和endtime，step是时间间隔，单位：秒，缺省60。\n");
+        printf("threads 线程数，缺省取CPU核数，回补历史数据时按时间点分配，否则按站点范围分配。\n");
+        printf("stations 把站点参数文件中的站点扩充到stations个虚拟站点，用于压力测试，缺省或填0不扩充。\n");
+        printf("seed 随机数的种子，种子相同时生成的数据相同，与线程数无关，缺省或填now取当前时间。\n");
+        printf("connstr 数据库的连接参数，格式：ip,username,password,dbname,port，datafmt中有db时必须填写。\n\n");
 
         return -1;
     }
@@ -94,7 +220,9 @@ int main(int argc, char* argv[]) {
         return -1;
     }
 
-    PActive.AddPInfo(20, "crtsurfdata");
+    // 常驻内存运行时每分钟才生成一次数据，心跳的超时时间要大于一分钟
+    bool bDaemon = (argc >= 6 && strcmp(argv[5], "daemon") == 0);
+    PActive.AddPInfo(bDaemon ? 120 : 20, "crtsurfdata");
     logFile.Write("crtsurfdata 开始运行\n");
 
     // TODO: @sugar 业务代码
@@ -103,31 +231,76 @@ int main(int argc, char* argv[]) {
         return -1;  // 加载失败
     }
 
-    // 获取当前时间作为观测时间
-    memset(strDateTime, 0, sizeof strDateTime);
-    if (argc == 5) {
-        LocalTime(strDateTime, "yyyymmddhh24miss");
-    } else {
-        STRCPY(strDateTime, sizeof(strDateTime), argv[5]);
-    }
+    // 设置随机数种子
+    randSeed = (argc >= 9 && strcmp(argv[8], "now") != 0) ? strtoull(argv[8], 0, 10) : time(0);
+    logFile.Write("随机数种子%llu\n", (unsigned long long)randSeed);
 
-    // 模拟生成全国气象站点分钟观测数据，存放在vsurfdata容器中
-    creatSurfData();
+    // 把站点扩充到指定的数量
+    if (argc >= 8 && atoi(argv[7]) > 0) {
+        expandSTCode(atoi(argv[7]));
+    }
 
-    // 打开程序的日志文件
-    if (strstr(argv[4], "json") != 0) {
-        creatSurfFile(argv[2], "json");
-        logFile.Write("生成json数据\n");
+    // 观测数据直接插入数据库，在生成数据之前连接好
+    if (hasDataFmt(argv[4], "db")) {
+#ifdef WITH_MYSQL
+        if (argc < 10) {
+            logFile.Write("datafmt中有db时必须填写connstr参数\n");
+            return -1;
+        }
+        if (!connectSurfDB(argv[9])) {
+            return -1;
+        }
+#else
+        logFile.Write("编译时没有定义WITH_MYSQL，不支持db输出方式，请用make crtsurfdata_db编译\n");
+        return -1;
+#endif
     }
-    if (strstr(argv[4], "xml") != 0) {
-        creatSurfFile(argv[2], "xml");
-        logFile.Write("生成xml数据\n");
+
+    int threads = (argc >= 7) ? atoi(argv[6]) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+
+    if (bDaemon) {
+        runDaemon(argv[1], argv[2], argv[4], threads, (argc >= 8) ? atoi(argv[7]) : 0);
+        return 0;
     }
-    if (strstr(argv[4], "csv") != 0) {
-        creatSurfFile(argv[2], "csv");
-        logFile.Write("生成csv数据\n");
+
+    CTimer timer;   // 统计生成数据的耗时
+
+    if (argc >= 6 && strchr(argv[5], ',') != 0) {
+        // 如果参数中的时间包括逗号，是按时间范围回补历史数据
+        if (!backfill(argv[2], argv[4], argv[5], threads)) {
+            return -1;
+        }
+    } else {
+        // 获取当前时间作为观测时间
+        char strDateTime[21];   // 观测数据的时间
+        memset(strDateTime, 0, sizeof strDateTime);
+        if (argc == 5 || strcmp(argv[5], "now") == 0) {
+            LocalTime(strDateTime, "yyyymmddhh24miss");
+        } else {
+            STRCPY(strDateTime, sizeof(strDateTime), argv[5]);
+        }
+
+        // 模拟生成全国气象站点分钟观测数据，存放在vsurfdata容器中
+        vector<struct st_surfcompact> vsurfdata;
+        creatSurfData(strDateTime, vsurfdata, threads);
+
+        // 把观测数据写入数据文件，全部格式一次生成
+        if (!creatSurfFile(argv[2], argv[4], strDateTime, vsurfdata)) {
+            logFile.Write("生成数据时间%s的数据失败\n", strDateTime);
+            return -1;
+        }
     }
 
+    // 统计生成的速度和内存的峰值，ru_maxrss的单位是KB
+    double elapsed = timer.Elapsed();
+    if (elapsed <= 0) elapsed = 0.000001;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    logFile.Write("统计：格式%s，站点数%d，记录数%ld，字节数%ld，耗时%.3f秒，记录/秒%.0f，字节/秒%.0f，内存峰值%ldKB\n",
+                  argv[4], (int)vstcode.size(), statRecords, statBytes, elapsed,
+                  statRecords / elapsed, statBytes / elapsed, usage.ru_maxrss);
+
     logFile.Write("crtsurfdata 运行结束\n");
 
     return 0;
@@ -139,8 +312,8 @@ bool loadSTCode(const char* iniFile) {
         logFile.Write("file.Open(%s) failed\n", iniFile);
         return false;
     }
+    vector<struct st_stcode> vtmp;  // 先加载到临时容器中，成功后再替换vstcode
     char strBuffer[301];
-    CCmdStr cmdStr;
     struct st_stcode stcode;
     while (true) {
         // 从站点参数读取一行，如果已经读取完毕，跳出循环
@@ -149,19 +322,20 @@ bool loadSTCode(const char* iniFile) {
             break;
         }
 
-        // 把读取到的每一行拆分
-        cmdStr.SplitToCmd(strBuffer, ",", true); 
-        if (cmdStr.CmdCount() != 6) continue;   // 扔掉无效行         
-        cmdStr.GetValue(0, stcode.provName, 30);    // 省
-        cmdStr.GetValue(1, stcode.obtid, 10);       // 站号
-        cmdStr.GetValue(2, stcode.obtName, 30);     // 站名         
-        cmdStr.GetValue(3, &stcode.lat);            // 纬度
-        cmdStr.GetValue(4, &stcode.lon);            // 经度 
-        cmdStr.GetValue(5, &stcode.height);         // 海拔高度
+        // 把读取到的每一行解析到结构体中，字段数不是6个的是无效行，扔掉
+        memset(&stcode, 0, sizeof(stcode));
+        if (!stcodeRecord.Parse(strBuffer, stcode)) continue;
 
         // 把结构体存入容器
-        vstcode.push_back(stcode);
+        vtmp.push_back(stcode);
+    }
+    file.Close();
+
+    if (vtmp.empty()) {
+        logFile.Write("站点参数文件%s中没有有效的站点\n", iniFile);
+        return false;
     }
+    vstcode.swap(vtmp);
     /* 测试代码
     for (auto& item : vstcode) {
         logFile.Write("%s, %s, %s, %.02f, %.02f, %.02f\n", item.provName, item.obTid, item.obtName, item.lat, item.lon, item.height);
@@ -170,96 +344,512 @@ bool loadSTCode(const char* iniFile) {
     return true;
 }
 
-void creatSurfData() {
-    // 设置随机数种子
-    srand(time(0));
+void expandSTCode(int stations) {
+    int count = vstcode.size();
+    if (count == 0) return;
+
+    // 站点数量比stations少就扩充，比stations多就截取
+    CRandom random(randSeed);
+    vstcode.reserve(stations);
+    for (int i = count; i < stations; ++i) {
+        struct st_stcode stcode = vstcode[i % count];
+        // 虚拟站点的代码，obtid只能存放10个字符，序号取后9位
+        snprintf(stcode.obtid, sizeof(stcode.obtid), "V%09u", (unsigned)i % 1000000000u);
+        stcode.lat += (random.Rand(2001) - 1000) / 10000.0;          // 纬度偏移±0.1度
+        stcode.lon += (random.Rand(2001) - 1000) / 10000.0;          // 经度偏移±0.1度
+        vstcode.push_back(stcode);
+    }
+    vstcode.resize(stations);
+
+    logFile.Write("站点数量从%d个调整为%d个\n", count, stations);
+}
+
+void creatSurfData(const char* dateTime, vector<struct st_surfcompact>& vsurfdata, int threads) {
+    PROFILE("creatSurfData");
+
+    int count = vstcode.size();
+    vsurfdata.resize(count);
+
+    // 站点少的时候不值得创建线程
+    if (threads > count / 1000) threads = count / 1000;
+    if (threads <= 1) {
+        struct st_filltask task = {dateTime, &vsurfdata, 0, count};
+        fillSurfData(&task);
+        return;
+    }
+
+    // 把站点按范围平均分给每个线程
+    vector<struct st_filltask> vtask(threads);
+    vector<pthread_t> vthid(threads);
+    for (int i = 0; i < threads; ++i) {
+        vtask[i].dateTime = dateTime;
+        vtask[i].vsurfdata = &vsurfdata;
+        vtask[i].begin = (long)count * i / threads;
+        vtask[i].end = (long)count * (i + 1) / threads;
+        if (pthread_create(&vthid[i], nullptr, fillSurfData, &vtask[i]) != 0) {
+            fillSurfData(&vtask[i]);    // 创建线程失败就在当前线程中生成
+            vthid[i] = 0;
+        }
+    }
+    for (int i = 0; i < threads; ++i) {
+        if (vthid[i] != 0) pthread_join(vthid[i], nullptr);
+    }
+}
+
+void* fillSurfData(void* arg) {
+    struct st_filltask* task = (struct st_filltask*)arg;
+    uint64_t timeSeed = CRandom::Mix(randSeed, strtoull(task->dateTime, 0, 10));
+    CRandom random;
 
-    struct st_surfdata st_surfdata;
     // 遍历气象站点参数容器
-    for (int i = 0; i < vstcode.size(); ++i) {
-        memset(&st_surfdata, 0, sizeof st_surfdata);
-        // 用随机数填充分钟观测数据的结构体
-        strncpy(st_surfdata.obtid, vstcode[i].obtid, 10);   // 站点代码。
-        strncpy(st_surfdata.dateTime, strDateTime, 14);     // 数据时间：格式yyyymmddhh24miss
-        st_surfdata.t = rand() % 351;                       // 气温：单位，0.1摄氏度
-        st_surfdata.p = rand() % 265 + 10000;               // 气压：0.1百帕
-        st_surfdata.u = rand() % 100 + 1;                   // 相对湿度，0-100之间的值。
-        st_surfdata.wd = rand() % 360;                      // 风向，0-360之间的值。
-        st_surfdata.wf = rand() % 150;                      // 风速：单位0.1m/s
-        st_surfdata.r = rand() % 16;                        // 降雨量：0.1mm
-        st_surfdata.vis = rand() % 5001 + 100000;           // 能见度：0.1米
-        // 把观测数据的结构体放入容器中
-        vsurfdata.push_back(st_surfdata);
+    for (int i = task->begin; i < task->end; ++i) {
+        struct st_surfcompact& surfdata = (*task->vsurfdata)[i];
+        // 每个站点的随机数序列只由种子、数据时间和站点序号决定
+        random.Seed(CRandom::Mix(timeSeed, i));
+        // 用随机数填充分钟观测数据的结构体，取值范围都在紧凑格式的范围内
+        surfdata.stidx = i;                             // 站点序号，站点代码是vstcode[i].obtid。
+        surfdata.t = random.Rand(351);                  // 气温：单位，0.1摄氏度
+        surfdata.p = random.Rand(265) + 10000;          // 气压：0.1百帕
+        surfdata.u = random.Rand(100) + 1;              // 相对湿度，0-100之间的值。
+        surfdata.wd = random.Rand(360);                 // 风向，0-360之间的值。
+        surfdata.wf = random.Rand(150);                 // 风速：单位0.1m/s
+        surfdata.r = random.Rand(16);                   // 降雨量：0.1mm
+        surfdata.vis = random.Rand(5001) + 100000;      // 能见度：0.1米
+    }
+
+    return nullptr;
+}
+
+// 把一条记录添加到builder中，xml、json和csv格式共用，字段名和格式由builder决定
+void surfRecord(CStrBuilder& builder, const char* dateTime, const struct st_surfcompact& surfdata) {
+    builder.BeginRecord();
+    builder.AddField("obtid", vstcode[surfdata.stidx].obtid);
+    builder.AddField("ddatetime", dateTime);
+    builder.AddTenths("t", surfdata.t);
+    builder.AddTenths("p", surfdata.p);
+    builder.AddField("u", surfdata.u);
+    builder.AddField("wd", surfdata.wd);
+    builder.AddTenths("wf", surfdata.wf);
+    builder.AddTenths("r", surfdata.r);
+    builder.AddTenths("vis", surfdata.vis);
+    builder.EndRecord();
+}
+
+// 把vsurfdata按列写入二进制列存数据文件，文件格式见_surfdata.h
+bool binColumns(CFile& file, const char* dateTime, const vector<struct st_surfcompact>& vsurfdata) {
+    int count = vsurfdata.size();
+    int stcount = vstcode.size();
+
+    struct st_surfbinhead head;
+    memset(&head, 0, sizeof head);
+    strcpy(head.magic, SURFBIN_MAGIC);
+    head.version = SURFBIN_VERSION;
+    head.count = count;
+    head.stcount = stcount;
+    STRNCPY(head.dateTime, sizeof(head.dateTime), dateTime, 14);
+    if (file.Fwrite(&head, sizeof head) != sizeof head) return false;
+
+    // 站点代码表
+    vector<char> stcode((size_t)stcount * SURFBIN_OBTIDLEN, 0);
+    for (int i = 0; i < stcount; ++i) {
+        strncpy(&stcode[(size_t)i * SURFBIN_OBTIDLEN], vstcode[i].obtid, SURFBIN_OBTIDLEN - 1);
+    }
+    if (file.Fwrite(stcode.data(), stcode.size()) != stcode.size()) return false;
+
+    // 遍历一次vsurfdata，把每条记录拆分到各列中，站点序号就是vstcode的下标
+    vector<int> columns((size_t)count * SURFBIN_COLUMNS);
+    int* stidx = columns.data();
+    int* t = stidx + count;
+    int* p = t + count;
+    int* u = p + count;
+    int* wd = u + count;
+    int* wf = wd + count;
+    int* r = wf + count;
+    int* vis = r + count;
+    for (int i = 0; i < count; ++i) {
+        stidx[i] = vsurfdata[i].stidx;
+        t[i] = vsurfdata[i].t;
+        p[i] = vsurfdata[i].p;
+        u[i] = vsurfdata[i].u;
+        wd[i] = vsurfdata[i].wd;
+        wf[i] = vsurfdata[i].wf;
+        r[i] = vsurfdata[i].r;
+        vis[i] = vsurfdata[i].vis;
     }
+    size_t size = columns.size() * sizeof(int);
+    if (file.Fwrite(columns.data(), size) != size) return false;
+
+    return true;
 }
 
+// 支持的数据文件格式
+struct st_surffmt surffmts[] = {
+    {"json", STRB_JSON, R"({"data":[)", "]}\n", nullptr},
+    {"xml", STRB_XML, "<data>\n", "</data>\n", nullptr},
+    {"csv", STRB_CSV, "站点代码,数据时间,气温,气压,相对湿度,风向,风速,降雨量,能见度\n", "", nullptr},
+    {"bin", 0, nullptr, nullptr, binColumns},
+};
+
+#define MAXSURFFMT (sizeof(surffmts) / sizeof(surffmts[0]))
+
 // 把容器vsurfdata中的所有全国气象观测数据写入文件
-bool creatSurfFile(const char* outpath, const char* datafmt) {
-    CFile file;
-    
-    // 拼接生成数据的文件名，例如：SURF_ZH_20220829092200_2222.csv
-    char strFileName[301];
-    sprintf(strFileName, "%s/SURF_ZH_%s_%d.%s", outpath, strDateTime, getpid(), datafmt);
-    // 打开文件
-    if (!file.OpenForRename(strFileName, "w")) {
-        logFile.Write("file.OpenForRename(%s) failed\n", strFileName);
-        return false;
+bool creatSurfFile(const char* outpath, const char* datafmt, const char* dateTime, const vector<struct st_surfcompact>& vsurfdata) {
+    PROFILE("creatSurfFile");
+
+    CFile files[MAXSURFFMT];                // 每种格式一个文件
+    CStrBuilder builders[MAXSURFFMT];       // 每种行存格式一个，记录先生成到这里，再分段写入文件
+    char strFileNames[MAXSURFFMT][301];     // 每种格式的文件名
+    struct st_surffmt* fmts[MAXSURFFMT];    // 本次需要生成的格式，行存格式在前，列存格式在后
+    int fmtCount = 0;
+    int rowCount = 0;                       // 行存格式的数量
+    bool bOK = true;                        // 全部格式是否都生成成功，有一种失败就返回false
+
+    // 打开全部需要生成的数据文件，格式在这里选定一次，surffmts中行存格式排在列存格式的前面
+    for (size_t i = 0; i < MAXSURFFMT; ++i) {
+        // 格式后面紧跟".gz"的，生成gzip压缩的数据文件
+        bool bGzip = false;
+        if (!hasDataFmt(datafmt, surffmts[i].datafmt, &bGzip)) continue;
+
+        // 拼接生成数据的文件名，例如：SURF_ZH_20220829092200_2222.csv或SURF_ZH_20220829092200_2222.csv.gz
+        sprintf(strFileNames[fmtCount], "%s/SURF_ZH_%s_%d.%s%s", outpath, dateTime, getpid(), surffmts[i].datafmt, bGzip ? ".gz" : "");
+        // 打开文件
+        bool bOpened = bGzip ? files[fmtCount].OpenGzipForRename(strFileNames[fmtCount])
+                             : files[fmtCount].OpenForRename(strFileNames[fmtCount], "w");
+        if (!bOpened) {
+            logFile.Write("file.OpenForRename(%s) failed\n", strFileNames[fmtCount]);
+            return false;   // 已打开的临时文件由CFile的析构函数删除
+        }
+        fmts[fmtCount] = &surffmts[i];
+        if (fmts[fmtCount]->writeColumns == nullptr) {
+            // 写入文件头
+            builders[fmtCount].SetFormat(fmts[fmtCount]->builderfmt);
+            builders[fmtCount].Reserve(SURFFLUSHSIZE + 1024);
+            builders[fmtCount].Append(fmts[fmtCount]->head);
+            ++rowCount;
+        }
+        ++fmtCount;
     }
-    // 写入第一行标题
-    if (strcmp(datafmt, "csv") == 0) {
-        file.Fprintf("站点代码,数据时间,气温,气压,相对湿度,风向,风速,降雨量,能见度\n");
-    } else if (strcmp(datafmt, "xml") == 0) {
-        file.Fprintf("<data>\n");
-    } else if (strcmp(datafmt, "json") == 0) {
-        file.Fprintf(R"({"data":[)");
-    }
-    
-    // 遍历存放观测数据的vsurfdata容器
-    for (int i = 0; i < vsurfdata.size(); ++i) {
-        // 写入一条记录
-        if (strcmp(datafmt, "csv") == 0) {
-            file.Fprintf("%s,%s,%.1f,%.1f,%d,%d,%.1f,%.1f,%.1f\n",
-                         vsurfdata[i].obtid, vsurfdata[i].dateTime,
-                         vsurfdata[i].t / 10.0, vsurfdata[i].p / 10.0,
-                         vsurfdata[i].u, vsurfdata[i].wd,
-                         vsurfdata[i].wf / 10.0, vsurfdata[i].r / 10.0,
-                         vsurfdata[i].vis / 10.0);
-        } else if (strcmp(datafmt, "xml") == 0) {
-            file.Fprintf(
-                "<obtid>%s</obtid><ddatetime>%s</ddatetime><t>%.1f</t><p>%.1f</p>"
-                "<u>%d</u><wd>%d</wd><wf>%.1f</wf><r>%.1f</r><vis>%.1f</vis><endl/>\n",
-                vsurfdata[i].obtid, vsurfdata[i].dateTime,
-                vsurfdata[i].t / 10.0, vsurfdata[i].p / 10.0, vsurfdata[i].u,
-                vsurfdata[i].wd, vsurfdata[i].wf / 10.0, vsurfdata[i].r / 10.0,
-                vsurfdata[i].vis / 10.0);
-        } else if (strcmp(datafmt, "json") == 0) {
-            file.Fprintf(
-                "{\"obtid\":\"%s\",\"ddatetime\":\"%s\",\"t\":\"%.1f\",\"p\":"
-                "\"%.1f\","
-                "\"u\":\"%d\",\"wd\":\"%d\",\"wf\":\"%.1f\",\"r\":\"%.1f\","
-                "\"vis\":\"%.1f\"}",
-                vsurfdata[i].obtid, vsurfdata[i].dateTime, vsurfdata[i].t / 10.0,
-                vsurfdata[i].p / 10.0, vsurfdata[i].u, vsurfdata[i].wd,
-                vsurfdata[i].wf / 10.0, vsurfdata[i].r / 10.0,
-                vsurfdata[i].vis / 10.0);
-            if (i != vsurfdata.size() - 1) {
-                file.Fprintf(",");
+
+    // 遍历存放观测数据的vsurfdata容器，只遍历一次，每条记录写入全部行存格式的文件
+    for (size_t i = 0; i < vsurfdata.size(); ++i) {
+        for (int j = 0; j < rowCount; ++j) {
+            surfRecord(builders[j], dateTime, vsurfdata[i]);
+            if (builders[j].Length() >= SURFFLUSHSIZE) {
+                files[j].Append(builders[j].c_str(), builders[j].Length());
+                builders[j].ClearBuffer();
             }
-        } 
+        }
     }
 
-    if (strcmp(datafmt, "xml") == 0) {
-        file.Fprintf("</data>\n");
-    } else if (strcmp(datafmt, "json") == 0) {
-        file.Fprintf("]}\n");
+    for (int j = 0; j < fmtCount; ++j) {
+        if (j < rowCount) {
+            // 写入剩余的记录和文件尾
+            builders[j].Append(fmts[j]->tail);
+            files[j].Append(builders[j].c_str(), builders[j].Length());
+        } else if (!fmts[j]->writeColumns(files[j], dateTime, vsurfdata)) {
+            // 写入列存数据失败，CFile的析构函数会删除临时文件
+            logFile.Write("写入数据文件%s失败\n", strFileNames[j]);
+            bOK = false;
+            continue;
+        }
+        // 关闭文件，压缩文件在关闭时才写入文件尾，失败了不能当作成功
+        if (!files[j].CloseAndRename()) {
+            logFile.Write("file.CloseAndRename(%s) failed\n", strFileNames[j]);
+            bOK = false;
+            continue;
+        }
+
+        UTime(strFileNames[j], dateTime);    // 修改文件的时间属性
+
+        // 累加统计信息
+        struct stat st_filestat;
+        if (stat(strFileNames[j], &st_filestat) == 0) {
+            __sync_fetch_and_add(&statBytes, (long)st_filestat.st_size);
+        }
+        __sync_fetch_and_add(&statRecords, (long)vsurfdata.size());
+
+        logFile.Write("生成数据文件%s成功，数据时间%s，记录数%d\n", strFileNames[j], dateTime, (int)vsurfdata.size());
+    }
+
+#ifdef WITH_MYSQL
+    // 把观测数据插入数据库
+    if (hasDataFmt(datafmt, "db") && !insertSurfDB(dateTime, vsurfdata)) {
+        bOK = false;
+    }
+#endif
+
+    return bOK;
+}
+
+bool hasDataFmt(const char* datafmt, const char* fmt, bool* bGzip) {
+    CCmdStr cmdStr;
+    cmdStr.SplitToView(datafmt, ",", true);
+
+    size_t len = strlen(fmt);
+    for (const string_view& token : cmdStr.m_vCmdView) {
+        if (token == fmt) {
+            if (bGzip != nullptr) *bGzip = false;
+            return true;
+        }
+        if (bGzip != nullptr && token.size() == len + 3 && token.compare(0, len, fmt) == 0 && token.substr(len) == ".gz") {
+            *bGzip = true;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#ifdef WITH_MYSQL
+
+// 把第position个绑定变量开始的9个变量与一条记录绑定
+void bindSurfRow(sqlstatement& stmt, int position, struct st_surfdata& row) {
+    stmt.bindin(position, row.obtid, 10);
+    stmt.bindin(position + 1, row.dateTime, 14);
+    stmt.bindin(position + 2, &row.t);
+    stmt.bindin(position + 3, &row.p);
+    stmt.bindin(position + 4, &row.u);
+    stmt.bindin(position + 5, &row.wd);
+    stmt.bindin(position + 6, &row.wf);
+    stmt.bindin(position + 7, &row.r);
+    stmt.bindin(position + 8, &row.vis);
+}
+
+// 拼接插入rows条记录的insert语句，一条语句多个values，减少与数据库的交互次数
+// 返回值：true-成功；false-失败，失败的原因在stmt.m_cda.message中
+bool prepareSurfInsert(sqlstatement& stmt, int rows) {
+    string strSQL = "insert into T_ZHOBTMIND(obtid,ddatetime,t,p,u,wd,wf,r,vis) values";
+    char strValues[201];
+    for (int i = 0; i < rows; ++i) {
+        int position = i * 9 + 1;
+        snprintf(strValues, sizeof(strValues), "%s(:%d,to_date(:%d,'yyyymmddhh24miss'),:%d,:%d,:%d,:%d,:%d,:%d,:%d)",
+                 (i == 0) ? "" : ",", position, position + 1, position + 2, position + 3,
+                 position + 4, position + 5, position + 6, position + 7, position + 8);
+        strSQL += strValues;
+    }
+    if (stmt.prepare("%s", strSQL.c_str()) != 0) return false;
+    for (int i = 0; i < rows; ++i) {
+        bindSurfRow(stmt, i * 9 + 1, dbRows[i]);
+    }
+    return true;
+}
+
+// 把vsurfdata中从begin开始的rows条记录转换到dbRows中，站点代码从vstcode中取，数据时间是dateTime
+void fillDBRows(const char* dateTime, const vector<struct st_surfcompact>& vsurfdata, int begin, int rows) {
+    for (int i = 0; i < rows; ++i) {
+        const struct st_surfcompact& surfdata = vsurfdata[begin + i];
+        struct st_surfdata& row = dbRows[i];
+        STRNCPY(row.obtid, sizeof(row.obtid), vstcode[surfdata.stidx].obtid, 10);
+        STRNCPY(row.dateTime, sizeof(row.dateTime), dateTime, 14);
+        row.t = surfdata.t;
+        row.p = surfdata.p;
+        row.u = surfdata.u;
+        row.wd = surfdata.wd;
+        row.wf = surfdata.wf;
+        row.r = surfdata.r;
+        row.vis = surfdata.vis;
     }
+}
+
+bool connectSurfDB(const char* connstr) {
+    if (conn.connecttodb(connstr, "utf8") != 0) {
+        logFile.Write("connect database(%s) failed.\n%s\n", connstr, conn.m_cda.message);
+        return false;
+    }
+
+    // insert语句只准备一次，以后每批记录只需要复制到dbRows中再执行
+    stmtBatch.connect(&conn);
+    if (!prepareSurfInsert(stmtBatch, SURFDB_BATCH)) {
+        logFile.Write("stmtBatch.prepare() failed.\n%s\n", stmtBatch.m_cda.message);
+        return false;
+    }
+    stmtRest.connect(&conn);
+    restRows = 0;
+
+    logFile.Write("连接数据库成功，每条insert语句插入%d条记录\n", SURFDB_BATCH);
+
+    return true;
+}
+
+bool insertSurfDB(const char* dateTime, const vector<struct st_surfcompact>& vsurfdata) {
+    pthread_mutex_lock(&dbMutex);
 
-    // 关闭文件
-    file.CloseAndRename();
+    int count = vsurfdata.size();
+    int i = 0;
+    int iret = 0;
+
+    // 先按SURFDB_BATCH条一批插入，剩下不足一批的用一条insert语句插入
+    for (; iret == 0 && i + SURFDB_BATCH <= count; i += SURFDB_BATCH) {
+        fillDBRows(dateTime, vsurfdata, i, SURFDB_BATCH);
+        PROFILE("sqlstatement::execute(batch)");
+        if ((iret = stmtBatch.execute()) != 0) {
+            logFile.Write("stmtBatch.execute() failed.\n%s\n", stmtBatch.m_cda.message);
+        }
+    }
+    if (iret == 0 && i < count) {
+        // 剩余的记录数与上次不同时才重新准备语句，每个时间点的记录数一般是相同的
+        int rows = count - i;
+        if (rows != restRows) {
+            restRows = 0;
+            if (!prepareSurfInsert(stmtRest, rows)) {
+                logFile.Write("stmtRest.prepare() failed.\n%s\n", stmtRest.m_cda.message);
+                iret = -1;
+            } else {
+                restRows = rows;
+            }
+        }
+        if (iret == 0) {
+            fillDBRows(dateTime, vsurfdata, i, rows);
+            PROFILE("sqlstatement::execute(rest)");
+            if ((iret = stmtRest.execute()) != 0) {
+                logFile.Write("stmtRest.execute() failed.\n%s\n", stmtRest.m_cda.message);
+            }
+        }
+    }
+
+    // 一个时间点的数据一次提交，要么全部入库，要么全部不入库
+    if (iret != 0) {
+        conn.rollback();
+        pthread_mutex_unlock(&dbMutex);
+        return false;
+    }
+    conn.commit();
 
-    UTime(strFileName, strDateTime);    // 修改文件的时间属性
+    pthread_mutex_unlock(&dbMutex);
 
-    logFile.Write("生成数据文件%s成功，数据时间%s，记录数%d\n", strFileName, strDateTime, vsurfdata.size());
+    logFile.Write("插入数据库成功，数据时间%s，记录数%d\n", dateTime, count);
 
     return true;
-}
\ No newline at end of file
+}
+#endif
+
+void runDaemon(const char* iniFile, const char* outpath, const char* datafmt, int threads, int stations) {
+    // 记录站点参数文件的修改时间
+    struct stat st_filestat;
+    time_t iniMTime = (stat(iniFile, &st_filestat) == 0) ? st_filestat.st_mtime : 0;
+
+    vector<struct st_surfcompact> vsurfdata;   // 循环使用，避免每分钟重新分配内存
+    char strDateTime[21];
+
+    logFile.Write("常驻内存运行，每分钟生成一次数据\n");
+
+    // 统计热点代码的耗时，kill -USR1 进程编号 把统计结果写入日志
+    CProfiler::Enable(&logFile);
+
+    time_t nextTime = time(0);
+    nextTime = nextTime - nextTime % 60 + 60;
+
+    while (true) {
+        // 等待到下一分钟的整点，收到SIGUSR1信号时sleep会提前返回，先写入耗时统计再继续等待
+        time_t now = time(0);
+        if (now < nextTime) {
+            sleep(nextTime - now);
+            CProfiler::CheckDump();
+            continue;
+        }
+        nextTime = now - now % 60 + 60;
+
+        PActive.UptATime();     // 更新进程的心跳
+
+        // 站点参数文件的修改时间变化了才重新加载
+        if (stat(iniFile, &st_filestat) == 0 && st_filestat.st_mtime != iniMTime) {
+            iniMTime = st_filestat.st_mtime;
+            if (loadSTCode(iniFile)) {
+                logFile.Write("重新加载站点参数文件%s，站点数%d\n", iniFile, (int)vstcode.size());
+                if (stations > 0) expandSTCode(stations);
+            }
+        }
+
+        LocalTime(strDateTime, "yyyymmddhh24miss");
+        creatSurfData(strDateTime, vsurfdata, threads);
+        if (!creatSurfFile(outpath, datafmt, strDateTime, vsurfdata)) {
+            // 常驻内存运行时不退出，下一分钟继续生成，失败的时间点记录在日志中，可以用回补的方式重新生成
+            logFile.Write("生成数据时间%s的数据失败\n", strDateTime);
+        }
+    }
+}
+
+void* backfillThread(void* arg) {
+    struct st_backfill* task = (struct st_backfill*)arg;
+    vector<struct st_surfcompact> vsurfdata;   // 每个线程一个容器，循环使用
+
+    while (true) {
+        // 领取一个时间点，全部领取完了就退出
+        pthread_mutex_lock(&task->mutex);
+        int pos = task->next++;
+        pthread_mutex_unlock(&task->mutex);
+        if (pos >= (int)task->vdateTime.size()) break;
+
+        const char* dateTime = task->vdateTime[pos].c_str();
+        creatSurfData(dateTime, vsurfdata);
+        if (!creatSurfFile(task->outpath, task->datafmt, dateTime, vsurfdata)) {
+            pthread_mutex_lock(&task->mutex);
+            task->vfailed.push_back(dateTime);
+            pthread_mutex_unlock(&task->mutex);
+        }
+
+        PActive.UptATime();     // 更新进程的心跳
+    }
+
+    return nullptr;
+}
+
+bool backfill(const char* outpath, const char* datafmt, const char* range, int threads) {
+    // 解析时间范围
+    CCmdStr cmdStr(range, ",", true);
+    char beginTime[21], endTime[21];
+    int step = 60;
+    cmdStr.GetValue(0, beginTime, 20);
+    cmdStr.GetValue(1, endTime, 20);
+    if (cmdStr.CmdCount() > 2) {
+        cmdStr.GetValue(2, &step);
+    }
+
+    time_t tbegin = strtotime(beginTime);
+    time_t tend = strtotime(endTime);
+    if (tbegin == -1 || tend == -1 || tbegin > tend || step <= 0) {
+        logFile.Write("时间范围%s不正确\n", range);
+        return false;
+    }
+    if (threads <= 0) threads = 1;
+
+    // 先在主线程中生成全部的时间点，各线程只从中领取
+    struct st_backfill task;
+    task.outpath = outpath;
+    task.datafmt = datafmt;
+    task.next = 0;
+    pthread_mutex_init(&task.mutex, nullptr);
+    char dateTime[21];
+    for (time_t t = tbegin; t <= tend; t += step) {
+        timetostr(t, dateTime, "yyyymmddhh24miss");
+        task.vdateTime.push_back(dateTime);
+    }
+    if (threads > (int)task.vdateTime.size()) threads = task.vdateTime.size();
+
+    logFile.Write("开始回补历史数据，时间范围%s，时间点%d个，线程数%d\n", range, (int)task.vdateTime.size(), threads);
+
+    vector<pthread_t> vthid(threads);
+    for (int i = 0; i < threads; ++i) {
+        if (pthread_create(&vthid[i], nullptr, backfillThread, &task) != 0) {
+            logFile.Write("pthread_create() failed\n");
+            threads = i;    // 只等待已经创建的线程
+            break;
+        }
+    }
+    for (int i = 0; i < threads; ++i) {
+        pthread_join(vthid[i], nullptr);
+    }
+
+    pthread_mutex_destroy(&task.mutex);
+
+    // 失败的时间点逐个写入日志，可以只对这些时间点重新回补
+    for (auto& dateTime : task.vfailed) {
+        logFile.Write("生成数据时间%s的数据失败\n", dateTime.c_str());
+    }
+    if (!task.vfailed.empty()) {
+        logFile.Write("回补历史数据完成，失败的时间点%d个\n", (int)task.vfailed.size());
+        return false;
+    }
+
+    return threads > 0;
+}
@@ -14,6 +14,7 @@
 #include <strings.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -32,23 +33,33 @@
 #include <sys/stat.h>
 #include <sys/epoll.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/sem.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/timerfd.h>
+#include <sys/syscall.h>
+#include <zlib.h>
 
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <charconv>
 #include <cstdlib>
 #include <cstring>
 #include <list>
 #include <vector>
+#include <unordered_map>
 #include <deque>
 #include <algorithm>
+#include <atomic>
+#include <tuple>
+#include <utility>
 
 // 采用stl标准库的命名空间std
 using namespace std;
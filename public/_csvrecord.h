@@ -0,0 +1,156 @@
+/**
+ * @file _csvrecord.h
+ * @brief 此程序是开发框架CSV记录与结构体绑定的模板，结构体的字段只描述一次，编译时生成每种结构体专用的解析和写入代码
+ * @author Sugar (hzzou@dhu.edu.cn)
+ * @date 2022-09-18
+ */
+
+#ifndef __CSVRECORD_H
+#define __CSVRECORD_H
+
+#include "_public.h"
+
+///////////////////////////////////// /////////////////////////////////////
+// 用法示例：
+//   struct st_stcode { char provName[31]; char obtid[11]; double lat; };
+//   constexpr CCSVRecord stcodeRecord(CSVField("provName", &st_stcode::provName),
+//                                     CSVField("obtid", &st_stcode::obtid),
+//                                     CSVField("lat", &st_stcode::lat));
+//   stcodeRecord.Parse("安徽,58015,34.27", stcode);   // 把一行CSV解析到结构体中
+//   stcodeRecord.Write(file, stcode);                   // 把结构体写成一行CSV
+// 字段的顺序就是CSV中列的顺序，支持的成员类型有char[N]、int、unsigned int、long、unsigned long和double。
+// 解析时直接在行内容中查找分隔符，数值字段直接从行内容中转换，不拆分成string，不分配内存。
+
+// 结构体S中类型为T的成员的描述。
+template <typename S, typename T>
+struct st_csvfield {
+    const char* name;   // 字段名，写入CSV文件头时使用。
+    T S::*member;       // 成员指针，相当于成员在结构体中的偏移。
+    int maxlen;         // 字符串成员最多存放的字节数，0表示取成员的大小减1，数值成员忽略此参数。
+};
+
+// 生成成员的描述，name：字段名；member：成员指针，例如&st_stcode::obtid；maxlen：字符串成员的最大长度，缺省取成员的大小减1。
+template <typename S, typename T>
+constexpr st_csvfield<S, T> CSVField(const char* name, T S::*member, const int maxlen = 0) {
+    return st_csvfield<S, T>{name, member, maxlen};
+}
+
+// 以下是各种类型的成员从CSV字段中解析和写入CSV文件的函数，在CCSVRecord类的外部不需要调用。
+namespace csvrecord {
+
+// 字符串成员，超出maxlen的内容被截断。
+template <size_t N>
+inline void ParseValue(const char* field, size_t len, char (&value)[N], int maxlen) {
+    size_t ilen = (maxlen > 0 && maxlen < (int)N) ? maxlen : N - 1;
+    if (len > ilen) len = ilen;
+    memcpy(value, field, len);
+    value[len] = 0;
+}
+
+// 整数成员，与atol函数相同，忽略前导的空白字符，遇到非数字字符结束，与CCmdStr共用开发框架的ParseLong函数。
+inline void ParseValue(const char* field, size_t len, int& value, int) { value = ParseLong(string_view(field, len)); }
+inline void ParseValue(const char* field, size_t len, unsigned int& value, int) { value = ParseLong(string_view(field, len)); }
+inline void ParseValue(const char* field, size_t len, long& value, int) { value = ParseLong(string_view(field, len)); }
+inline void ParseValue(const char* field, size_t len, unsigned long& value, int) { value = ParseLong(string_view(field, len)); }
+
+// 浮点数成员，atof需要以0结尾的字符串，复制到栈上的缓冲区中再转换。
+inline void ParseValue(const char* field, size_t len, double& value, int) {
+    char strTemp[64];
+    if (len > sizeof(strTemp) - 1) len = sizeof(strTemp) - 1;
+    memcpy(strTemp, field, len);
+    strTemp[len] = 0;
+    value = atof(strTemp);
+}
+
+template <size_t N>
+inline void WriteValue(CFile& file, const char (&value)[N]) { file.Append(value); }
+inline void WriteValue(CFile& file, const int value) { file.AppendInt(value); }
+inline void WriteValue(CFile& file, const unsigned int value) { file.AppendInt(value); }
+inline void WriteValue(CFile& file, const long value) { file.AppendInt(value); }
+inline void WriteValue(CFile& file, const unsigned long value) { file.AppendInt(value); }
+
+// 浮点数成员，用能精确还原的最短格式，例如1234567.8写成"1234567.8"，用atof读回来与原值相同。
+inline void WriteValue(CFile& file, const double value) {
+    char strTemp[32];
+    file.Append(strTemp, std::to_chars(strTemp, strTemp + sizeof(strTemp), value).ptr - strTemp);
+}
+
+}  // namespace csvrecord
+
+// CSV记录与结构体S的绑定，T...是各成员的类型，由构造函数的参数推导，不需要写出来。
+template <typename S, typename... T>
+class CCSVRecord {
+   private:
+    std::tuple<st_csvfield<S, T>...> m_fields;  // 全部成员的描述。
+
+    // 解析一个字段，pos是字段开始的位置，解析后指向下一个字段开始的位置。
+    // blast：是否是最后一个字段，最后一个字段后不能再有分隔符，其它字段后必须有分隔符。
+    template <typename F>
+    static bool ParseField(const F& field, const char*& pos, S& record, const char sep, const bool bdelspace, const bool blast) {
+        if (pos == 0) return false;
+
+        const char* end = strchr(pos, sep);
+        if ((end == 0) != blast) return false;  // 字段数与成员数不同。
+        if (end == 0) end = pos + strlen(pos);
+
+        const char* beg = pos;
+        pos = (*end == 0) ? end : end + 1;
+
+        // 删除字段前后的空格，只调整字段的起止位置。
+        if (bdelspace) {
+            while (beg < end && *beg == ' ') beg++;
+            while (end > beg && *(end - 1) == ' ') end--;
+        }
+
+        csvrecord::ParseValue(beg, end - beg, record.*field.member, field.maxlen);
+
+        return true;
+    }
+
+    template <size_t... I>
+    bool ParseFields(const char* pos, S& record, const char sep, const bool bdelspace, std::index_sequence<I...>) const {
+        return (ParseField(std::get<I>(m_fields), pos, record, sep, bdelspace, I == sizeof...(T) - 1) && ...);
+    }
+
+    template <size_t... I>
+    void WriteFields(CFile& file, const S& record, const char sep, std::index_sequence<I...>) const {
+        ((I > 0 ? file.AppendChar(sep) : void(), csvrecord::WriteValue(file, record.*std::get<I>(m_fields).member)), ...);
+    }
+
+    template <size_t... I>
+    void WriteNames(CFile& file, const char sep, std::index_sequence<I...>) const {
+        ((I > 0 ? file.AppendChar(sep) : void(), file.Append(std::get<I>(m_fields).name)), ...);
+    }
+
+   public:
+    // 构造函数，参数是用CSVField函数生成的成员描述，顺序与CSV中列的顺序相同。
+    constexpr CCSVRecord(st_csvfield<S, T>... fields) : m_fields(fields...) {}
+
+    // 获取字段的个数。
+    static constexpr int FieldCount() { return sizeof...(T); }
+
+    // 把一行CSV解析到结构体中。
+    // line：一行CSV的内容，不包括换行符。
+    // record：存放解析结果的结构体，字段数与成员数不同时，结构体中的内容不确定。
+    // sep：字段的分隔符，缺省是逗号。
+    // bdelspace：是否删除字段内容前后的空格，缺省删除。
+    // 返回值：true-成功；false-字段数与成员数不同。
+    bool Parse(const char* line, S& record, const char sep = ',', const bool bdelspace = true) const {
+        return ParseFields(line, record, sep, bdelspace, std::index_sequence_for<T...>{});
+    }
+
+    // 把结构体写成一行CSV，包括换行符，用CFile的Append系列方法写入，不调用printf函数族。
+    void Write(CFile& file, const S& record, const char sep = ',') const {
+        WriteFields(file, record, sep, std::index_sequence_for<T...>{});
+        file.AppendChar('\n');
+    }
+
+    // 把全部字段名写成一行，作为CSV文件的文件头。
+    void WriteHead(CFile& file, const char sep = ',') const {
+        WriteNames(file, sep, std::index_sequence_for<T...>{});
+        file.AppendChar('\n');
+    }
+};
+///////////////////////////////////// /////////////////////////////////////
+
+#endif
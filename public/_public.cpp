@@ -133,26 +133,218 @@ int SNPRINTF(char *dest,const size_t destlen,size_t n,const char *fmt,...)
   return ret;
 }
 
+///////////////////////////////////// /////////////////////////////////////
+// 以下是字符串处理函数的向量化实现，x86_64平台用SSE2（x86_64必然支持）或AVX2（运行时检测CPU），
+// 其它平台用逐字节处理的普通实现，不管用哪种实现，处理的结果都相同。
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+// 获取CPU支持的指令集，1-SSE2；2-AVX2，只检测一次，局部静态变量的初始化是线程安全的。
+static int SimdLevel()
+{
+  static const int level=(__builtin_cpu_init(),__builtin_cpu_supports("avx2") ? 2 : 1);
+
+  return level;
+}
+
+// 计算str开始连续等于chr的字符个数，最多len个。
+static size_t LSpanChar_SSE2(const char *str,size_t len,const char chr)
+{
+  __m128i vchr=_mm_set1_epi8(chr);
+  size_t ii=0;
+
+  for (;ii+16<=len;ii+=16)
+  {
+    unsigned mask=_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(str+ii)),vchr));
+    if (mask!=0xFFFF) return ii+__builtin_ctz(~mask);
+  }
+
+  while ( (ii<len) && (str[ii]==chr) ) ii++;
+
+  return ii;
+}
+
+__attribute__((target("avx2")))
+static size_t LSpanChar_AVX2(const char *str,size_t len,const char chr)
+{
+  __m256i vchr=_mm256_set1_epi8(chr);
+  size_t ii=0;
+
+  for (;ii+32<=len;ii+=32)
+  {
+    unsigned mask=_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(str+ii)),vchr));
+    if (mask!=0xFFFFFFFF) return ii+__builtin_ctz(~mask);
+  }
+
+  return ii+LSpanChar_SSE2(str+ii,len-ii,chr);
+}
+
+// 计算str结尾连续等于chr的字符个数，最多len个。
+static size_t RSpanChar_SSE2(const char *str,size_t len,const char chr)
+{
+  __m128i vchr=_mm_set1_epi8(chr);
+  size_t ii=len;
+
+  for (;ii>=16;ii-=16)
+  {
+    unsigned mask=_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(str+ii-16)),vchr));
+    if (mask!=0xFFFF) return len-(ii-16+32-__builtin_clz((~mask)&0xFFFF));
+  }
+
+  while ( (ii>0) && (str[ii-1]==chr) ) ii--;
+
+  return len-ii;
+}
+
+__attribute__((target("avx2")))
+static size_t RSpanChar_AVX2(const char *str,size_t len,const char chr)
+{
+  __m256i vchr=_mm256_set1_epi8(chr);
+  size_t ii=len;
+
+  for (;ii>=32;ii-=32)
+  {
+    unsigned mask=_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(str+ii-32)),vchr));
+    if (mask!=0xFFFFFFFF) return len-(ii-32+32-__builtin_clz(~mask));
+  }
+
+  return len-ii+RSpanChar_SSE2(str,ii,chr);
+}
+
+// 把str中lo和hi之间（包括lo和hi）的字母转换大小写，大写和小写字母的编码只相差0x20。
+static void FlipCase_SSE2(char *str,size_t len,const char lo,const char hi)
+{
+  __m128i vlo=_mm_set1_epi8(lo-1),vhi=_mm_set1_epi8(hi+1),vbit=_mm_set1_epi8(0x20);
+  size_t ii=0;
+
+  for (;ii+16<=len;ii+=16)
+  {
+    __m128i v=_mm_loadu_si128((const __m128i *)(str+ii));
+    __m128i m=_mm_and_si128(_mm_cmpgt_epi8(v,vlo),_mm_cmplt_epi8(v,vhi));
+    _mm_storeu_si128((__m128i *)(str+ii),_mm_xor_si128(v,_mm_and_si128(m,vbit)));
+  }
+
+  for (;ii<len;ii++)
+  {
+    if ( (str[ii] >= lo) && (str[ii] <= hi) ) str[ii]=str[ii] ^ 0x20;
+  }
+}
+
+__attribute__((target("avx2")))
+static void FlipCase_AVX2(char *str,size_t len,const char lo,const char hi)
+{
+  __m256i vlo=_mm256_set1_epi8(lo-1),vhi=_mm256_set1_epi8(hi+1),vbit=_mm256_set1_epi8(0x20);
+  size_t ii=0;
+
+  for (;ii+32<=len;ii+=32)
+  {
+    __m256i v=_mm256_loadu_si256((const __m256i *)(str+ii));
+    __m256i m=_mm256_and_si256(_mm256_cmpgt_epi8(v,vlo),_mm256_cmpgt_epi8(vhi,v));
+    _mm256_storeu_si256((__m256i *)(str+ii),_mm256_xor_si256(v,_mm256_and_si256(m,vbit)));
+  }
+
+  FlipCase_SSE2(str+ii,len-ii,lo,hi);
+}
+
+// 计算str开始连续是数字的字符个数，按16字节一块判断，返回值是16的倍数，最多len个。
+static size_t DigitBlocks_SSE2(const char *str,size_t len)
+{
+  __m128i vlo=_mm_set1_epi8('0'-1),vhi=_mm_set1_epi8('9'+1);
+  size_t ii=0;
+
+  for (;ii+16<=len;ii+=16)
+  {
+    __m128i v=_mm_loadu_si128((const __m128i *)(str+ii));
+    __m128i m=_mm_and_si128(_mm_cmpgt_epi8(v,vlo),_mm_cmplt_epi8(v,vhi));
+    if (_mm_movemask_epi8(m)!=0xFFFF) break;
+  }
+
+  return ii;
+}
+
+static size_t LSpanChar(const char *str,size_t len,const char chr)
+{
+  if (SimdLevel()==2) return LSpanChar_AVX2(str,len,chr);
+
+  return LSpanChar_SSE2(str,len,chr);
+}
+
+static size_t RSpanChar(const char *str,size_t len,const char chr)
+{
+  if (SimdLevel()==2) return RSpanChar_AVX2(str,len,chr);
+
+  return RSpanChar_SSE2(str,len,chr);
+}
+
+static void FlipCase(char *str,size_t len,const char lo,const char hi)
+{
+  if (SimdLevel()==2) { FlipCase_AVX2(str,len,lo,hi); return; }
+
+  FlipCase_SSE2(str,len,lo,hi);
+}
+
+static size_t DigitBlocks(const char *str,size_t len)
+{
+  return DigitBlocks_SSE2(str,len);
+}
+
+#else
+
+// 以下是逐字节处理的普通实现，用于不是x86_64的平台。
+static size_t LSpanChar(const char *str,size_t len,const char chr)
+{
+  size_t ii=0;
+
+  while ( (ii<len) && (str[ii]==chr) ) ii++;
+
+  return ii;
+}
+
+static size_t RSpanChar(const char *str,size_t len,const char chr)
+{
+  size_t ii=len;
+
+  while ( (ii>0) && (str[ii-1]==chr) ) ii--;
+
+  return len-ii;
+}
+
+static void FlipCase(char *str,size_t len,const char lo,const char hi)
+{
+  for (size_t ii=0;ii<len;ii++)
+  {
+    if ( (str[ii] >= lo) && (str[ii] <= hi) ) str[ii]=str[ii] ^ 0x20;
+  }
+}
+
+// 普通实现不按块处理，返回0，全部由调用者逐字节处理。
+static size_t DigitBlocks(const char *,size_t)
+{
+  return 0;
+}
+
+#endif
+///////////////////////////////////// /////////////////////////////////////
+
 // 删除字符串左边指定的字符。
 // str：待处理的字符串。
 // chr：需要删除的字符。
 void DeleteLChar(char *str,const char chr)
 {
   if (str == 0) return;
-  if (strlen(str) == 0) return;
-
-  char strTemp[strlen(str)+1];
 
-  int iTemp=0;
+  size_t istrlen=strlen(str);
 
-  memset(strTemp,0,sizeof(strTemp));
-  strcpy(strTemp,str);
+  if (istrlen == 0) return;
 
-  while ( strTemp[iTemp] == chr )  iTemp++;
+  size_t iTemp=LSpanChar(str,istrlen,chr);
 
-  memset(str,0,strlen(str)+1);
+  if (iTemp == 0) return;
 
-  strcpy(str,strTemp+iTemp);
+  // 把剩余的内容前移，原来结尾处空出来的位置清零
+  memmove(str,str+iTemp,istrlen-iTemp+1);
+  memset(str+istrlen-iTemp+1,0,iTemp);
 
   return;
 }
@@ -163,18 +355,14 @@ void DeleteLChar(char *str,const char chr)
 void DeleteRChar(char *str,const char chr)
 {
   if (str == 0) return;
-  if (strlen(str) == 0) return;
 
-  int istrlen = strlen(str);
+  size_t istrlen=strlen(str);
 
-  while (istrlen>0)
-  {
-    if (str[istrlen-1] != chr) break;
+  if (istrlen == 0) return;
 
-    str[istrlen-1]=0;
+  size_t iTemp=RSpanChar(str,istrlen,chr);
 
-    istrlen--;
-  }
+  memset(str+istrlen-iTemp,0,iTemp);
 }
 
 // 删除字符串左右两边指定的字符。
@@ -192,27 +380,17 @@ void ToUpper(char *str)
 {
   if (str == 0) return;
 
-  if (strlen(str) == 0) return;
-
-  int istrlen=strlen(str);
-
-  for (int ii=0;ii<istrlen;ii++)
-  {
-    if ( (str[ii] >= 'a') && (str[ii] <= 'z') ) str[ii]=str[ii] - 32;
-  }
+  FlipCase(str,strlen(str),'a','z');
 }
 
 void ToUpper(string &str)
 {
   if (str.empty()) return;
 
-  char strtemp[str.size()+1];
+  // 原来的实现复制到字符数组中转换，遇到字符串中的0就结束了，这里保持相同的结果。
+  str.resize(strlen(str.c_str()));
 
-  STRCPY(strtemp,sizeof(strtemp),str.c_str());
-
-  ToUpper(strtemp);
-
-  str=strtemp;
+  FlipCase(&str[0],str.size(),'a','z');
 
   return;
 }
@@ -223,27 +401,17 @@ void ToLower(char *str)
 {
   if (str == 0) return;
 
-  if (strlen(str) == 0) return;
-
-  int istrlen=strlen(str);
-
-  for (int ii=0;ii<istrlen;ii++)
-  {
-    if ( (str[ii] >= 'A') && (str[ii] <= 'Z') ) str[ii]=str[ii] + 32;
-  }
+  FlipCase(str,strlen(str),'A','Z');
 }
 
 void ToLower(string &str)
 {
   if (str.empty()) return;
 
-  char strtemp[str.size()+1];
-
-  STRCPY(strtemp,sizeof(strtemp),str.c_str());
+  // 原来的实现复制到字符数组中转换，遇到字符串中的0就结束了，这里保持相同的结果。
+  str.resize(strlen(str.c_str()));
 
-  ToLower(strtemp);
-
-  str=strtemp;
+  FlipCase(&str[0],str.size(),'A','Z');
 
   return;
 }
@@ -266,37 +434,62 @@ void UpdateStr(char *str,const char *str1,const char *str2,bool bloop)
   // 如果bloop为true并且str2中包函了str1的内容，直接返回，因为会进入死循环，最终导致内存溢出。
   if ( (bloop==true) && (strstr(str2,str1) != nullptr) ) return;
 
-  // 尽可能分配更多的空间，但仍有可能出现内存溢出的情况，最好优化成string。
-  int ilen=strlen(str)*10;
-  if (ilen<1000) ilen=1000;
+  size_t len1=strlen(str1),len2=strlen(str2);
 
-  char strTemp[ilen];
+  // str1为空时任何位置都能匹配上，不替换。
+  if (len1 == 0) return;
 
-  char *strStart=str;
+  char *strPos=strstr(str,str1);
 
-  char *strPos=0;
+  if (strPos == 0) return;
 
-  while (true)
+  if (bloop == true)
   {
-    if (bloop == true)
+    // 每次替换最靠前的str1，替换后新出现的str1不会在strPos-len1+1之前，从那里继续查找，不必从头查找。
+    while (strPos != 0)
     {
-      strPos=strstr(str,str1);
+      memmove(strPos+len2,strPos+len1,strlen(strPos+len1)+1);
+      memcpy(strPos,str2,len2);
+
+      size_t ipos=strPos-str;
+      strPos=strstr(str+( (ipos+1>len1) ? ipos+1-len1 : 0 ),str1);
     }
-    else
+
+    return;
+  }
+
+  // 不循环替换，从左到右只扫描一遍，替换后的内容不再参与查找。
+  if (len2 <= len1)
+  {
+    // 替换后不会变长，直接在str中从前往后写，写入的位置不会超过读取的位置。
+    char *strDst=strPos,*strSrc=strPos;
+
+    while ( (strPos=strstr(strSrc,str1)) != 0 )
     {
-      strPos=strstr(strStart,str1);
+      memmove(strDst,strSrc,strPos-strSrc); strDst=strDst+(strPos-strSrc);
+      memcpy(strDst,str2,len2);             strDst=strDst+len2;
+      strSrc=strPos+len1;
     }
 
-    if (strPos == 0) break;
+    memmove(strDst,strSrc,strlen(strSrc)+1);
+
+    return;
+  }
 
-    memset(strTemp,0,sizeof(strTemp));
-    STRNCPY(strTemp,sizeof(strTemp),str,strPos-str);
-    STRCAT(strTemp,sizeof(strTemp),str2);
-    STRCAT(strTemp,sizeof(strTemp),strPos+strlen(str1));
-    strcpy(str,strTemp);
+  // 替换后会变长，先写入临时的string中，再复制回str。
+  string strTemp(str,strPos-str);
+  char *strSrc=strPos;
 
-    strStart=strPos+strlen(str2);
+  while ( (strPos=strstr(strSrc,str1)) != 0 )
+  {
+    strTemp.append(strSrc,strPos-strSrc);
+    strTemp.append(str2,len2);
+    strSrc=strPos+len1;
   }
+
+  strTemp.append(strSrc);
+
+  memcpy(str,strTemp.c_str(),strTemp.size()+1);
 }
 
 // 从一个字符串中提取出数字的内容，存放到另一个字符串中。
@@ -309,10 +502,8 @@ void PickNumber(const char *src,char *dest,const bool bsigned,const bool bdot)
   if (dest==0) return;    // 判断空指针。
   if (src==0) { strcpy(dest,""); return; }
 
-  char strtemp[strlen(src)+1];
-  memset(strtemp,0,sizeof(strtemp));
-  strcpy(strtemp,src);
-  DeleteLRChar(strtemp,' ');
+  // 空格不会被提取，不需要先删除src前后的空格，直接处理src。
+  const char *strtemp=src;
 
   int ipossrc,iposdst,ilen;
   ipossrc=iposdst=ilen=0;
@@ -321,6 +512,15 @@ void PickNumber(const char *src,char *dest,const bool bsigned,const bool bdot)
 
   for (ipossrc=0;ipossrc<ilen;ipossrc++)
   {
+    // 连续16个字符都是数字的，整块复制。
+    size_t iblock=DigitBlocks(strtemp+ipossrc,ilen-ipossrc);
+    if (iblock>0)
+    {
+      memmove(dest+iposdst,strtemp+ipossrc,iblock);
+      iposdst=iposdst+iblock; ipossrc=ipossrc+iblock;
+      if (ipossrc>=ilen) break;
+    }
+
     if ( (bsigned==true) && (strtemp[ipossrc] == '+') )
     {
       dest[iposdst++]=strtemp[ipossrc]; continue;
@@ -354,60 +554,211 @@ bool MatchStr(const string &str,const string &rules)
   // 如果被比较的字符串是"*"，返回true
   if (rules == "*") return true;
 
-  int ii,jj;
-  int  iPOS1,iPOS2;
-  CCmdStr CmdStr,CmdSubStr;
+  CMatchRule MatchRule(rules.c_str());
+
+  return MatchRule.Match(str.c_str());
+}
+
+CMatchRule::CMatchRule()
+{
+  m_bAll=false;
+}
+
+CMatchRule::CMatchRule(const char *rules)
+{
+  m_bAll=false;
+
+  Compile(rules);
+}
+
+// 编译匹配规则。
+void CMatchRule::Compile(const char *rules)
+{
+  m_vrules.clear();
+  m_bAll=false;
+
+  if (rules == 0) return;
 
-  string strFileName,strMatchStr;
+  string strRules=rules;
 
-  strFileName=str;
-  strMatchStr=rules;
+  // 把规则转换成大写，匹配时只需要转换被比较的字符串
+  ToUpper(strRules);
 
-  // 把字符串都转换成大写后再来比较
-  ToUpper(strFileName);
-  ToUpper(strMatchStr);
+  CCmdStr CmdStr,CmdSubStr;
 
-  CmdStr.SplitToCmd(strMatchStr,",");
+  CmdStr.SplitToCmd(strRules,",");
 
-  for (ii=0;ii<CmdStr.CmdCount();ii++)
+  for (int ii=0;ii<CmdStr.CmdCount();ii++)
   {
     // 如果为空，就一定要跳过，否则就会被配上
     if (CmdStr.m_vCmdStr[ii].empty() == true) continue;
 
-    iPOS1=iPOS2=0;
     CmdSubStr.SplitToCmd(CmdStr.m_vCmdStr[ii],"*");
 
-    for (jj=0;jj<CmdSubStr.CmdCount();jj++)
+    struct st_rule strule;
+
+    strule.bStar=(CmdSubStr.CmdCount() > 1);
+    strule.prefix=CmdSubStr.m_vCmdStr[0];
+    strule.minlen=strule.prefix.size();
+
+    if (strule.bStar == true)
     {
-      // 如果是文件名的首部
-      if (jj == 0)
-      {
-        if (strncmp(strFileName.c_str(),CmdSubStr.m_vCmdStr[jj].c_str(),CmdSubStr.m_vCmdStr[jj].size()) != 0) break;
-      }
+      // 只有星号的规则匹配任意字符串
+      if (CmdStr.m_vCmdStr[ii].find_first_not_of('*') == string::npos) { m_bAll=true; continue; }
+
+      strule.suffix=CmdSubStr.m_vCmdStr[CmdSubStr.CmdCount()-1];
+      strule.minlen=strule.minlen+strule.suffix.size();
 
-      // 如果是文件名的尾部
-      if (jj == CmdSubStr.CmdCount()-1)
+      for (int jj=1;jj<CmdSubStr.CmdCount()-1;jj++)
       {
-        if (strcmp(strFileName.c_str()+strFileName.size()-CmdSubStr.m_vCmdStr[jj].size(),CmdSubStr.m_vCmdStr[jj].c_str()) != 0) break;
+        // 连续的星号之间是空的，不需要匹配
+        if (CmdSubStr.m_vCmdStr[jj].empty() == true) continue;
+
+        strule.vmiddle.push_back(CmdSubStr.m_vCmdStr[jj]);
+        strule.minlen=strule.minlen+CmdSubStr.m_vCmdStr[jj].size();
       }
+    }
+
+    m_vrules.push_back(strule);
+  }
+}
+
+// 判断str开始的part.size()字节是否与part相同，忽略大小写，part已转换为大写。
+bool CMatchRule::EqualUpper(const char *str,const string &part)
+{
+  for (size_t ii=0;ii<part.size();ii++)
+  {
+    char cc=str[ii];
+
+    if ( (cc >= 'a') && (cc <= 'z') ) cc=cc - 32;
+
+    if (cc != part[ii]) return false;
+  }
+
+  return true;
+}
+
+// 判断字符串是否匹配规则。
+bool CMatchRule::Match(const char *str) const
+{
+  if (str == 0) return false;
+
+  if (m_bAll == true) return true;
+
+  size_t len=strlen(str);
+
+  for (size_t ii=0;ii<m_vrules.size();ii++)
+  {
+    const struct st_rule &strule=m_vrules[ii];
+
+    if (len < strule.minlen) continue;
+
+    // 没有星号的规则，必须与字符串完全相同
+    if (strule.bStar == false)
+    {
+      if ( (len == strule.minlen) && (EqualUpper(str,strule.prefix) == true) ) return true;
+
+      continue;
+    }
+
+    // 比较首部和尾部
+    if (EqualUpper(str,strule.prefix) == false) continue;
 
-      iPOS2=strFileName.find(CmdSubStr.m_vCmdStr[jj],iPOS1);
+    if (EqualUpper(str+len-strule.suffix.size(),strule.suffix) == false) continue;
 
-      if (iPOS2 < 0) break;
+    // 在首部和尾部之间按顺序查找中间部分，每一部分取最靠前的位置
+    size_t ipos=strule.prefix.size();
+    size_t iend=len-strule.suffix.size();
+    size_t jj=0;
 
-      iPOS1=iPOS2+CmdSubStr.m_vCmdStr[jj].size();
+    for (jj=0;jj<strule.vmiddle.size();jj++)
+    {
+      const string &part=strule.vmiddle[jj];
+
+      while ( (ipos+part.size() <= iend) && (EqualUpper(str+ipos,part) == false) ) ipos++;
+
+      if (ipos+part.size() > iend) break;
+
+      ipos=ipos+part.size();
     }
 
-    if (jj==CmdSubStr.CmdCount()) return true;
+    if (jj == strule.vmiddle.size()) return true;
   }
 
   return false;
 }
 
+// 把整数转换为十进制的字符串，写入buffer中，不调用printf函数族，不分配内存。
+// 返回值：写入buffer的字节数，注意，buffer的结尾不会补0。
+int FormatInt(char *buffer,long value)
+{
+  char strtemp[21];   // long的最大值是19位数字。
+  int  ipos=sizeof(strtemp);
+  int  ilen=0;
+
+  // 用无符号数计算，避免取反LONG_MIN时溢出。
+  unsigned long uvalue=value;
+  if (value<0) { buffer[ilen++]='-'; uvalue=0-uvalue; }
+
+  // 从低位到高位依次取出每一位数字。
+  do
+  {
+    strtemp[--ipos]='0'+uvalue%10;
+    uvalue=uvalue/10;
+  } while (uvalue>0);
+
+  memcpy(buffer+ilen,strtemp+ipos,sizeof(strtemp)-ipos);
+
+  return ilen+sizeof(strtemp)-ipos;
+}
+
+// 把以0.1为单位的整数转换为一位小数的字符串，写入buffer中，结果与printf("%.1f",value/10.0)相同。
+// 返回值：写入buffer的字节数，注意，buffer的结尾不会补0。
+int FormatTenths(char *buffer,long value)
+{
+  int ilen=0;
+
+  unsigned long uvalue=value;
+  if (value<0) { buffer[ilen++]='-'; uvalue=0-uvalue; }
+
+  // 整数部分，再加小数点和一位小数。
+  ilen=ilen+FormatInt(buffer+ilen,uvalue/10);
+  buffer[ilen++]='.';
+  buffer[ilen++]='0'+uvalue%10;
+
+  return ilen;
+}
+
+// 从字段中解析整数，与atol函数相同，忽略前导的空白字符，遇到非数字字符结束，字段不需要以0结尾。
+long ParseLong(string_view field)
+{
+  size_t ii=0;
+
+  while ( (ii<field.size()) && (isspace((unsigned char)field[ii])) ) ii++;
+
+  bool bneg=false;
+
+  if ( (ii<field.size()) && ( (field[ii]=='-') || (field[ii]=='+') ) ) { bneg=(field[ii]=='-'); ii++; }
+
+  unsigned long uvalue=0;
+
+  for (;(ii<field.size()) && (field[ii]>='0') && (field[ii]<='9');ii++)
+  {
+    uvalue=uvalue*10+(field[ii]-'0');
+  }
+
+  return bneg ? 0-uvalue : uvalue;
+}
+
 CFile::CFile()   // 类的构造函数
 {
   m_fp=0;
+  m_abuflen=0;
   m_bEnBuffer=true;
+  m_bGzip=false;
+  m_bWriteErr=false;
+  m_abuffer=0;
+  m_zstream=0;
   memset(m_filename,0,sizeof(m_filename));
   memset(m_filenametmp,0,sizeof(m_filenametmp));
 }
@@ -417,6 +768,11 @@ void CFile::Close()
 {
   if (m_fp==0) return;    // 判断空指针。
 
+  Flush();       // 把写缓冲区中的内容写入文件。
+
+  // 释放压缩数据流，没有调用CloseAndRename的压缩文件是不完整的，临时文件会被删除。
+  GzipRelease();
+
   fclose(m_fp);  // 关闭文件指针
 
   m_fp=0;
@@ -441,6 +797,10 @@ bool CFile::CloseAndRemove()
 {
   if (m_fp==0) return true;    // 判断空指针。
 
+  m_abuflen=0;   // 文件将被删除，丢弃写缓冲区中的内容。
+
+  GzipRelease();
+
   fclose(m_fp);  // 关闭文件指针
 
   m_fp=0;
@@ -456,6 +816,8 @@ bool CFile::CloseAndRemove()
 CFile::~CFile()   // 类的析构函数
 {
   Close();
+
+  delete [] m_abuffer;
 }
 
 // 打开文件，参数与FOPEN相同，打开成功true，失败返回false
@@ -470,6 +832,7 @@ bool CFile::Open(const char *filename,const char *openmode,bool bEnBuffer)
   STRNCPY(m_filename,sizeof(m_filename),filename,300);
 
   m_bEnBuffer=bEnBuffer;
+  m_bWriteErr=false;
 
   return true;
 }
@@ -488,16 +851,95 @@ bool CFile::OpenForRename(const char *filename,const char *openmode,bool bEnBuff
   if ( (m_fp=FOPEN(m_filenametmp,openmode)) == 0 ) return false;
 
   m_bEnBuffer=bEnBuffer;
+  m_bWriteErr=false;
+
+  return true;
+}
+
+// 专为改名而打开文件，以gzip格式压缩写入，打开成功true，失败返回false
+bool CFile::OpenGzipForRename(const char *filename,const int level)
+{
+  if (OpenForRename(filename,"w",true)==false) return false;
+
+  m_zstream=new z_stream;
+  memset(m_zstream,0,sizeof(z_stream));
+
+  // windowBits加16表示生成gzip格式的文件头和文件尾，而不是zlib格式。
+  if (deflateInit2(m_zstream,level,Z_DEFLATED,15+16,8,Z_DEFAULT_STRATEGY) != Z_OK)
+  {
+    delete m_zstream; m_zstream=0;
+    Close(); return false;
+  }
+
+  m_bGzip=true;
 
   return true;
 }
 
+// 结束gzip压缩，把压缩数据流中剩余的内容和gzip文件尾写入文件。
+bool CFile::GzipFinish()
+{
+  char outbuf[CFILE_APPENDSIZE];
+  int  iret;
+
+  m_zstream->next_in=0;
+  m_zstream->avail_in=0;
+
+  do
+  {
+    m_zstream->next_out=(Bytef *)outbuf;
+    m_zstream->avail_out=sizeof(outbuf);
+
+    iret=deflate(m_zstream,Z_FINISH);
+
+    if (iret==Z_STREAM_ERROR) break;
+
+    size_t have=sizeof(outbuf)-m_zstream->avail_out;
+
+    if (fwrite(outbuf,1,have,m_fp) != have) { iret=Z_ERRNO; break; }
+  } while (iret != Z_STREAM_END);
+
+  GzipRelease();
+
+  return iret==Z_STREAM_END;
+}
+
+// 释放gzip压缩的数据流。
+void CFile::GzipRelease()
+{
+  if (m_bGzip==false) return;
+
+  deflateEnd(m_zstream);
+
+  delete m_zstream;
+
+  m_zstream=0;
+  m_bGzip=false;
+}
+
 // 关闭文件并改名
 bool CFile::CloseAndRename()
 {
   if (m_fp==0) return false;    // 判断空指针。
 
-  fclose(m_fp);  // 关闭文件指针
+  Flush();       // 把写缓冲区中的内容写入文件。
+
+  bool bGzipOK=true;
+
+  if (m_bGzip==true) bGzipOK=GzipFinish();   // 写入gzip文件尾。
+
+  // 写入过程中出现过错误（例如磁盘空间不足）也不能改名，fclose成功并不表示之前的写入都成功了。
+  bool bWriteOK=( (m_bWriteErr == false) && (ferror(m_fp) == 0) );
+
+  // 关闭文件指针，写入失败、压缩失败或关闭失败都不能改名，否则会留下不完整的文件。
+  if ( (fclose(m_fp) != 0) || (bGzipOK == false) || (bWriteOK == false) )
+  {
+    m_fp=0;
+    remove(m_filenametmp);
+    memset(m_filename,0,sizeof(m_filename));
+    memset(m_filenametmp,0,sizeof(m_filenametmp));
+    return false;
+  }
 
   m_fp=0;
 
@@ -520,17 +962,151 @@ void CFile::Fprintf(const char *fmt,...)
 {
   if ( m_fp == 0 ) return;
 
+  Flush();   // 先写入写缓冲区中的内容，保证写入的顺序。
+
   va_list arg;
   va_start( arg, fmt );
-  vfprintf( m_fp, fmt, arg );
-  va_end( arg );
 
-  if ( m_bEnBuffer == false ) fflush(m_fp);
-}
+  if (m_bGzip == true)
+  {
+    // 压缩写入时，先格式化到内存中，再压缩写入文件。
+    va_list argcopy;
+    va_copy( argcopy, arg );
+    int len=vsnprintf( 0, 0, fmt, argcopy );
+    va_end( argcopy );
 
-// 调用fgets从文件中读取一行，bDelCRT=true删除换行符，false不删除，缺省为false
-bool CFile::Fgets(char *buffer,const int readsize,bool bdelcrt)
+    if (len > 0)
+    {
+      char *buffer=new char[len+1];
+      vsnprintf( buffer, len+1, fmt, arg );
+      WriteOut(buffer,len);
+      delete [] buffer;
+    }
+  }
+  else
+    vfprintf( m_fp, fmt, arg );
+
+  va_end( arg );
+
+  if ( m_bEnBuffer == false ) fflush(m_fp);
+}
+
+// 把内容写入文件，如果是gzip压缩写入，先压缩再写入。
+size_t CFile::WriteOut(const void *ptr,size_t size)
+{
+  if (m_bGzip == false)
+  {
+    size_t tt=fwrite(ptr,1,size,m_fp);
+
+    if (tt != size) m_bWriteErr=true;
+
+    return tt;
+  }
+
+  char outbuf[CFILE_APPENDSIZE];
+
+  m_zstream->next_in=(Bytef *)ptr;
+  m_zstream->avail_in=size;
+
+  // 压缩后的内容可能比outbuf大，循环直到输入的内容全部压缩完。
+  do
+  {
+    m_zstream->next_out=(Bytef *)outbuf;
+    m_zstream->avail_out=sizeof(outbuf);
+
+    if (deflate(m_zstream,Z_NO_FLUSH) == Z_STREAM_ERROR) { m_bWriteErr=true; return 0; }
+
+    size_t have=sizeof(outbuf)-m_zstream->avail_out;
+
+    if (fwrite(outbuf,1,have,m_fp) != have) { m_bWriteErr=true; return 0; }
+  } while (m_zstream->avail_out == 0);
+
+  return size;
+}
+
+// 为Append系列方法准备len字节的空间，空间不足时先把写缓冲区中的内容写入文件。
+char *CFile::AppendReserve(const int len)
+{
+  // 只用Fprintf、Fwrite方法写入或只读取的文件不需要写缓冲区，第一次调用Append系列方法时才分配。
+  if (m_abuffer==0) m_abuffer=new char[CFILE_APPENDSIZE];
+
+  if (m_abuflen+len > CFILE_APPENDSIZE) Flush();
+
+  return m_abuffer+m_abuflen;
+}
+
+// 把写缓冲区中的内容写入文件。
+void CFile::Flush()
+{
+  if ( (m_fp == 0) || (m_abuflen == 0) ) return;
+
+  WriteOut(m_abuffer,m_abuflen);
+
+  m_abuflen=0;
+
+  if ( m_bEnBuffer == false ) fflush(m_fp);
+}
+
+// 追加len字节的内容。
+void CFile::Append(const char *str,const int len)
+{
+  if ( (m_fp == 0) || (str == 0) || (len <= 0) ) return;
+
+  // 比写缓冲区还大的内容直接写入文件。
+  if (len > CFILE_APPENDSIZE) { Flush(); WriteOut(str,len); return; }
+
+  memcpy(AppendReserve(len),str,len);
+  m_abuflen=m_abuflen+len;
+
+  if ( m_bEnBuffer == false ) Flush();
+}
+
+// 追加字符串。
+void CFile::Append(const char *str)
+{
+  if (str == 0) return;
+
+  Append(str,strlen(str));
+}
+
+// 追加一个字符。
+void CFile::AppendChar(const char chr)
+{
+  if ( m_fp == 0 ) return;
+
+  *AppendReserve(1)=chr;
+  m_abuflen++;
+
+  if ( m_bEnBuffer == false ) Flush();
+}
+
+// 追加整数，与"%ld"相同。
+void CFile::AppendInt(const long value)
+{
+  if ( m_fp == 0 ) return;
+
+  char *pos=AppendReserve(21);   // 可能会先写入文件，m_abuflen会被清零。
+  m_abuflen=m_abuflen+FormatInt(pos,value);
+
+  if ( m_bEnBuffer == false ) Flush();
+}
+
+// 追加以0.1为单位的整数，与"%.1f"格式的value/10.0相同。
+void CFile::AppendTenths(const long value)
+{
+  if ( m_fp == 0 ) return;
+
+  char *pos=AppendReserve(22);   // 可能会先写入文件，m_abuflen会被清零。
+  m_abuflen=m_abuflen+FormatTenths(pos,value);
+
+  if ( m_bEnBuffer == false ) Flush();
+}
+
+// 调用fgets从文件中读取一行，bDelCRT=true删除换行符，false不删除，缺省为false
+bool CFile::Fgets(char *buffer,const int readsize,bool bdelcrt)
 {
+  PROFILE("CFile::Fgets");
+
   if ( m_fp == 0 ) return false;
 
   memset(buffer,0,readsize+1);  // 调用者必须保证buffer的空间足够，否则这里会内存溢出。
@@ -567,7 +1143,9 @@ size_t CFile::Fwrite(const void *ptr, size_t size )
 {
   if ( m_fp == 0 ) return -1;
 
-  size_t tt=fwrite(ptr,1,size,m_fp);
+  Flush();   // 先写入写缓冲区中的内容，保证写入的顺序。
+
+  size_t tt=WriteOut(ptr,size);
 
   if ( m_bEnBuffer == false ) fflush(m_fp);
 
@@ -611,16 +1189,29 @@ bool FGETS(const FILE *fp,char *buffer,const int readsize,const char *endbz)
 
 CCmdStr::CCmdStr()
 {
+  m_bView=false;
   m_vCmdStr.clear();
 }
 
 CCmdStr::CCmdStr(const string &buffer,const char *sepstr,const bool bdelspace)
 {
+  m_bView=false;
   m_vCmdStr.clear();
 
   SplitToCmd(buffer,sepstr,bdelspace);
 }
 
+// 删除字段内容前后的空格，只调整字段的起止位置。
+static string_view TrimSpace(string_view field)
+{
+  size_t ibeg=0,iend=field.size();
+
+  while ( (ibeg<iend) && (field[ibeg]==' ') ) ibeg++;
+  while ( (iend>ibeg) && (field[iend-1]==' ') ) iend--;
+
+  return field.substr(ibeg,iend-ibeg);
+}
+
 // 把字符串拆分到m_vCmdStr容器中。
 // buffer：待拆分的字符串。
 // sepstr：buffer字符串中字段内容的分隔符，注意，分隔符是字符串，如","、" "、"|"、"~!~"。
@@ -629,96 +1220,119 @@ void CCmdStr::SplitToCmd(const string &buffer,const char *sepstr,const bool bdel
 {
   // 清除所有的旧数据
   m_vCmdStr.clear();
+  m_vCmdView.clear();
+  m_bView=false;
 
-  int iPOS=0;
-  string srcstr,substr;
-
-  srcstr=buffer;
+  // 从上一个分隔符之后开始查找，不截取剩余的字符串
+  string_view srcstr=buffer;
+  size_t seplen=strlen(sepstr);
+  size_t ibeg=0,ipos=0;
 
-  while ( (iPOS=srcstr.find(sepstr)) >= 0)
+  while ( (ipos=srcstr.find(sepstr,ibeg)) != string_view::npos)
   {
-    substr=srcstr.substr(0,iPOS);
+    string_view field=srcstr.substr(ibeg,ipos-ibeg);
 
-    if (bdelspace == true)
-    {
-      char str[substr.length()+1];
-      STRCPY(str,sizeof(str),substr.c_str());
+    if (bdelspace == true) field=TrimSpace(field);
 
-      DeleteLRChar(str,' ');
+    m_vCmdStr.emplace_back(field);
 
-      substr=str;
-    }
+    ibeg=ipos+seplen;
+  }
 
-    m_vCmdStr.push_back(substr);
+  string_view field=srcstr.substr(ibeg);
 
-    iPOS=iPOS+strlen(sepstr);
+  if (bdelspace == true) field=TrimSpace(field);
 
-    srcstr=srcstr.substr(iPOS,srcstr.size()-iPOS);
+  m_vCmdStr.emplace_back(field);
 
-  }
+  return;
+}
+
+// 把字符串拆分到m_vCmdView容器中，字段直接指向buffer中的内容。
+void CCmdStr::SplitToView(const char *buffer,const char *sepstr,const bool bdelspace)
+{
+  // 清除所有的旧数据
+  m_vCmdStr.clear();
+  m_vCmdView.clear();
+  m_bView=true;
 
-  substr=srcstr;
+  if (buffer == 0) return;
 
-  if (bdelspace == true)
+  string_view srcstr=buffer;
+  size_t seplen=strlen(sepstr);
+  size_t ibeg=0,ipos=0;
+
+  while ( (ipos=srcstr.find(sepstr,ibeg)) != string_view::npos)
   {
-    char str[substr.length()+1];
-    STRCPY(str,sizeof(str),substr.c_str());
+    string_view field=srcstr.substr(ibeg,ipos-ibeg);
+
+    if (bdelspace == true) field=TrimSpace(field);
 
-    DeleteLRChar(str,' ');
+    m_vCmdView.push_back(field);
 
-    substr=str;
+    ibeg=ipos+seplen;
   }
 
-  m_vCmdStr.push_back(substr);
+  string_view field=srcstr.substr(ibeg);
 
-  return;
+  if (bdelspace == true) field=TrimSpace(field);
+
+  m_vCmdView.push_back(field);
 }
 
 int CCmdStr::CmdCount()
 {
+  if (m_bView == true) return m_vCmdView.size();
+
   return m_vCmdStr.size();
 }
 
+// 获取第inum个字段的内容，不复制字符串。
+bool CCmdStr::GetField(const int inum,string_view &field)
+{
+  if ( (inum<0) || (inum>=CmdCount()) ) return false;
+
+  if (m_bView == true) field=m_vCmdView[inum];
+  else field=m_vCmdStr[inum];
+
+  return true;
+}
+
 bool CCmdStr::GetValue(const int inum,char *value,const int ilen)
 {
-  if ( (inum>=(int)m_vCmdStr.size()) || (value==0) ) return false;
+  string_view field;
+
+  if ( (value==0) || (GetField(inum,field)==false) ) return false;
 
   if (ilen>0) memset(value,0,ilen+1);   // 调用者必须保证value的空间足够，否则这里会内存溢出。
 
-  if ( (m_vCmdStr[inum].length()<=(unsigned int)ilen) || (ilen==0) )
-  {
-    strcpy(value,m_vCmdStr[inum].c_str());
-  }
-  else
-  {
-    strncpy(value,m_vCmdStr[inum].c_str(),ilen); value[ilen]=0;
-  }
+  size_t len=field.size();
+
+  if ( (ilen>0) && (len>(unsigned int)ilen) ) len=ilen;
+
+  memcpy(value,field.data(),len); value[len]=0;
 
   return true;
 }
 
 bool CCmdStr::GetValue(const int inum,int *value)
 {
-  if ( (inum>=(int)m_vCmdStr.size()) || (value==0) ) return false;
-
-  (*value) = 0;
+  string_view field;
 
-  if (inum >= (int)m_vCmdStr.size()) return false;
+  if ( (value==0) || (GetField(inum,field)==false) ) return false;
 
-  (*value) = atoi(m_vCmdStr[inum].c_str());
+  (*value) = ParseLong(field);
 
   return true;
 }
 
 bool CCmdStr::GetValue(const int inum,unsigned int *value)
 {
-  if ( (inum>=(int)m_vCmdStr.size()) || (value==0) ) return false;
-
-  (*value) = 0;
+  string_view field;
 
-  if (inum >= (int)m_vCmdStr.size()) return false;
+  if ( (value==0) || (GetField(inum,field)==false) ) return false;
 
-  (*value) = atoi(m_vCmdStr[inum].c_str());
+  (*value) = ParseLong(field);
 
   return true;
 }
@@ -726,57 +1340,62 @@ bool CCmdStr::GetValue(const int inum,unsigned int *value)
 
 bool CCmdStr::GetValue(const int inum,long *value)
 {
-  if ( (inum>=(int)m_vCmdStr.size()) || (value==0) ) return false;
-
-  (*value) = 0;
+  string_view field;
 
-  if (inum >= (int)m_vCmdStr.size()) return false;
+  if ( (value==0) || (GetField(inum,field)==false) ) return false;
 
-  (*value) = atol(m_vCmdStr[inum].c_str());
+  (*value) = ParseLong(field);
 
   return true;
 }
 
 bool CCmdStr::GetValue(const int inum,unsigned long *value)
 {
-  if ( (inum>=(int)m_vCmdStr.size()) || (value==0) ) return false;
-
-  (*value) = 0;
+  string_view field;
 
-  if (inum >= (int)m_vCmdStr.size()) return false;
+  if ( (value==0) || (GetField(inum,field)==false) ) return false;
 
-  (*value) = atol(m_vCmdStr[inum].c_str());
+  (*value) = ParseLong(field);
 
   return true;
 }
 
 bool CCmdStr::GetValue(const int inum,double *value)
 {
-  if ( (inum>=(int)m_vCmdStr.size()) || (value==0) ) return false;
+  string_view field;
+
+  if ( (value==0) || (GetField(inum,field)==false) ) return false;
 
   (*value) = 0;
 
-  if (inum >= (int)m_vCmdStr.size()) return false;
+  // atof需要以0结尾的字符串，数值的字段不会很长，复制到栈上的缓冲区中再转换。
+  char strTemp[64];
+  size_t len=field.size();
+  if (len>sizeof(strTemp)-1) len=sizeof(strTemp)-1;
+  memcpy(strTemp,field.data(),len); strTemp[len]=0;
 
-  (*value) = (double)atof(m_vCmdStr[inum].c_str());
+  (*value) = (double)atof(strTemp);
 
   return true;
 }
 
 bool CCmdStr::GetValue(const int inum,bool *value)
 {
-  if ( (inum>=(int)m_vCmdStr.size()) || (value==0) ) return false;
+  string_view field;
 
-  (*value) = 0;
+  if ( (value==0) || (GetField(inum,field)==false) ) return false;
+
+  (*value) = false;
 
-  if (inum >= (int)m_vCmdStr.size()) return false;
+  // 忽略大小写判断是否为"TRUE"，与原来只比较前10个字符的结果相同。
+  if ( (field.size()==4) && (strncasecmp(field.data(),"TRUE",4)==0) ) (*value)=true;
 
-  char strTemp[11];
-  memset(strTemp,0,sizeof(strTemp));
-  strncpy(strTemp,m_vCmdStr[inum].c_str(),10);
+  return true;
+}
 
-  ToUpper(strTemp);  // 转换为大写来判断。
-  if (strcmp(strTemp,"TRUE")==0) (*value)=true; 
+bool CCmdStr::GetValue(const int inum,string_view *value)
+{
+  if ( (value==0) || (GetField(inum,*value)==false) ) return false;
 
   return true;
 }
@@ -784,280 +1403,725 @@ bool CCmdStr::GetValue(const int inum,bool *value)
 CCmdStr::~CCmdStr()
 {
   m_vCmdStr.clear();
+  m_vCmdView.clear();
 }
 
-bool GetXMLBuffer(const char *xmlbuffer,const char *fieldname,char *value,const int ilen)
+// 从xml格式的字符串中查找字段的内容，不复制字符串。
+// 从xmlbuffer的开始查找第一个<fieldname>标签，再从它之后查找第一个</fieldname>标签，
+// 直接比较标签名，不再用SNPRINTF生成标签字符串。
+bool FindXMLField(const char *xmlbuffer,const char *fieldname,string_view *value)
 {
-  if (value==0) return false;    // 判断空指针。
-
-  if (ilen>0) memset(value,0,ilen+1);   // 调用者必须保证value的空间足够，否则这里会内存溢出。
+  if ( (xmlbuffer==0) || (fieldname==0) || (value==0) ) return false;    // 判断空指针。
 
-  char *start=0,*end=0;
-  char m_SFieldName[51],m_EFieldName[51];
+  size_t namelen=strlen(fieldname);
 
-  int m_NameLen = strlen(fieldname);
+  const char *start=xmlbuffer;
 
-  SNPRINTF(m_SFieldName,sizeof(m_SFieldName),50,"<%s>",fieldname);
-  SNPRINTF(m_EFieldName,sizeof(m_EFieldName),50,"</%s>",fieldname);
-
-  start=0; end=0;
-
-  start = (char *)strstr(xmlbuffer,m_SFieldName);
-
-  if (start != 0)
+  // 查找开始标签<fieldname>。
+  while ( (start=strchr(start,'<')) != 0)
   {
-    end   = (char *)strstr(start,m_EFieldName);
+    if ( (strncmp(start+1,fieldname,namelen)==0) && (start[namelen+1]=='>') ) break;
+    start++;
   }
 
-  if ((start==0) || (end == 0))
-  {
-    return false;
-  }
+  if (start==0) return false;
 
-  int   m_ValueLen = end - start - m_NameLen - 2 ;
+  const char *valbeg=start+namelen+2;
+  const char *end=valbeg;
 
-  if ( ((m_ValueLen) <= ilen) || (ilen == 0) )
-  {
-    strncpy(value,start+m_NameLen+2,m_ValueLen); value[m_ValueLen]=0;
-  }
-  else
+  // 查找结束标签</fieldname>。
+  while ( (end=strchr(end,'<')) != 0)
   {
-    strncpy(value,start+m_NameLen+2,ilen); value[ilen]=0;
+    if ( (end[1]=='/') && (strncmp(end+2,fieldname,namelen)==0) && (end[namelen+2]=='>') ) break;
+    end++;
   }
 
-  DeleteLRChar(value,' ');
+  if (end==0) return false;
+
+  (*value)=string_view(valbeg,end-valbeg);
 
   return true;
 }
 
-bool GetXMLBuffer(const char *xmlbuffer,const char *fieldname,bool *value)
+// 以下是把字段的内容转换为各种数据类型的函数，GetXMLBuffer函数族和CXMLRecord类共用。
+// bfound：是否找到了字段，没有找到时value被清空，返回失败。
+
+// 字符串，超出ilen的内容被截断，再删除前后的空格。
+static bool XMLValue(const bool bfound,const string_view &field,char *value,const int ilen)
 {
   if (value==0) return false;    // 判断空指针。
 
-  (*value) = false;
+  if (ilen>0) memset(value,0,ilen+1);   // 调用者必须保证value的空间足够，否则这里会内存溢出。
 
-  char strTemp[51];
+  if (bfound==false) return false;
 
-  memset(strTemp,0,sizeof(strTemp));
+  string_view strtmp=field;
 
-  if (GetXMLBuffer(xmlbuffer,fieldname,strTemp,10) == true)
-  {
-    ToUpper(strTemp);  // 转换为大写来判断。
-    if (strcmp(strTemp,"TRUE")==0) { (*value)=true; return true; }
-  }
+  if ( (ilen>0) && (strtmp.size()>(size_t)ilen) ) strtmp=strtmp.substr(0,ilen);
 
-  return false;
+  strtmp=TrimSpace(strtmp);
+
+  memcpy(value,strtmp.data(),strtmp.size()); value[strtmp.size()]=0;
+
+  return true;
 }
 
-bool GetXMLBuffer(const char *xmlbuffer,const char *fieldname,int *value)
+// 数值，最多取字段的前50个字节，复制到栈上的缓冲区中再转换。
+static bool XMLNumber(const bool bfound,const string_view &field,char *strTemp)
 {
-  if (value==0) return false;    // 判断空指针。
+  strTemp[0]=0;
 
-  (*value) = 0;
+  if (bfound==false) return false;
 
-  char strTemp[51];
+  size_t len=field.size();
 
-  memset(strTemp,0,sizeof(strTemp));
+  if (len>50) len=50;
 
-  if (GetXMLBuffer(xmlbuffer,fieldname,strTemp,50) == true)
-  {
-    (*value) = atoi(strTemp); return true;
-  }
+  memcpy(strTemp,field.data(),len); strTemp[len]=0;
 
-  return false;
+  return true;
 }
 
-bool GetXMLBuffer(const char *xmlbuffer,const char *fieldname,unsigned int *value)
+static bool XMLValue(const bool bfound,const string_view &field,bool *value)
 {
   if (value==0) return false;    // 判断空指针。
 
-  (*value) = 0;
+  (*value) = false;
 
-  char strTemp[51];
+  if (bfound==false) return false;
 
-  memset(strTemp,0,sizeof(strTemp));
+  // 最多取前10个字节，删除前后的空格后不区分大小写与TRUE比较。
+  string_view strtmp=field.substr(0,10);
 
-  if (GetXMLBuffer(xmlbuffer,fieldname,strTemp,50) == true)
-  {
-    (*value) = (unsigned int)atoi(strTemp); return true;
-  }
+  strtmp=TrimSpace(strtmp);
+
+  if ( (strtmp.size()==4) && (strncasecmp(strtmp.data(),"TRUE",4)==0) ) { (*value)=true; return true; }
 
   return false;
 }
 
-bool GetXMLBuffer(const char *xmlbuffer,const char *fieldname,long *value)
+static bool XMLValue(const bool bfound,const string_view &field,int *value)
 {
   if (value==0) return false;    // 判断空指针。
 
-  (*value) = 0;
-
   char strTemp[51];
 
-  memset(strTemp,0,sizeof(strTemp));
+  (*value) = 0;
 
-  if (GetXMLBuffer(xmlbuffer,fieldname,strTemp,50) == true)
-  {
-    (*value) = atol(strTemp); return true;
-  }
+  if (XMLNumber(bfound,field,strTemp) == false) return false;
 
-  return false;
+  (*value) = atoi(strTemp); return true;
 }
 
-bool GetXMLBuffer(const char *xmlbuffer,const char *fieldname,unsigned long *value)
+static bool XMLValue(const bool bfound,const string_view &field,unsigned int *value)
 {
   if (value==0) return false;    // 判断空指针。
 
-  (*value) = 0;
-
   char strTemp[51];
 
-  memset(strTemp,0,sizeof(strTemp));
+  (*value) = 0;
 
-  if (GetXMLBuffer(xmlbuffer,fieldname,strTemp,50) == true)
-  {
-    (*value) = (unsigned long)atol(strTemp); return true;
-  }
+  if (XMLNumber(bfound,field,strTemp) == false) return false;
 
-  return false;
+  (*value) = (unsigned int)atoi(strTemp); return true;
 }
 
-bool GetXMLBuffer(const char *xmlbuffer,const char *fieldname,double *value)
+static bool XMLValue(const bool bfound,const string_view &field,long *value)
 {
   if (value==0) return false;    // 判断空指针。
 
-  (*value) = 0;
-
   char strTemp[51];
 
-  memset(strTemp,0,sizeof(strTemp));
+  (*value) = 0;
 
-  if (GetXMLBuffer(xmlbuffer,fieldname,strTemp,50) == true)
-  {
-    (*value) = atof(strTemp); return true;
-  }
+  if (XMLNumber(bfound,field,strTemp) == false) return false;
 
-  return false;
+  (*value) = atol(strTemp); return true;
 }
 
-// 把整数表示的时间转换为字符串表示的时间。
-// ltime：整数表示的时间。
-// stime：字符串表示的时间。
-// fmt：输出字符串时间stime的格式，与LocalTime函数的fmt参数相同，如果fmt的格式不正确，stime将为空。
-void timetostr(const time_t ltime,char *stime,const char *fmt)
+static bool XMLValue(const bool bfound,const string_view &field,unsigned long *value)
 {
-  if (stime==0) return;    // 判断空指针。
+  if (value==0) return false;    // 判断空指针。
 
-  strcpy(stime,"");
+  char strTemp[51];
 
-  struct tm sttm = *localtime ( &ltime );
-  // struct tm sttm; localtime_r(&ltime,&sttm); 
+  (*value) = 0;
 
-  sttm.tm_year=sttm.tm_year+1900;
-  sttm.tm_mon++;
+  if (XMLNumber(bfound,field,strTemp) == false) return false;
 
-  if (fmt==0)
-  {
-    snprintf(stime,20,"%04u-%02u-%02u %02u:%02u:%02u",sttm.tm_year,
-                    sttm.tm_mon,sttm.tm_mday,sttm.tm_hour,
-                    sttm.tm_min,sttm.tm_sec);
-    return;
-  }
+  (*value) = (unsigned long)atol(strTemp); return true;
+}
 
-  if (strcmp(fmt,"yyyy-mm-dd hh24:mi:ss") == 0)
-  {
-    snprintf(stime,20,"%04u-%02u-%02u %02u:%02u:%02u",sttm.tm_year,
-                    sttm.tm_mon,sttm.tm_mday,sttm.tm_hour,
-                    sttm.tm_min,sttm.tm_sec);
-    return;
-  }
+static bool XMLValue(const bool bfound,const string_view &field,double *value)
+{
+  if (value==0) return false;    // 判断空指针。
 
-  if (strcmp(fmt,"yyyy-mm-dd hh24:mi") == 0)
-  {
-    snprintf(stime,17,"%04u-%02u-%02u %02u:%02u",sttm.tm_year,
-                    sttm.tm_mon,sttm.tm_mday,sttm.tm_hour,
-                    sttm.tm_min);
-    return;
-  }
+  char strTemp[51];
 
-  if (strcmp(fmt,"yyyy-mm-dd hh24") == 0)
-  {
-    snprintf(stime,14,"%04u-%02u-%02u %02u",sttm.tm_year,
-                    sttm.tm_mon,sttm.tm_mday,sttm.tm_hour);
-    return;
-  }
+  (*value) = 0;
 
-  if (strcmp(fmt,"yyyy-mm-dd") == 0)
-  {
-    snprintf(stime,11,"%04u-%02u-%02u",sttm.tm_year,sttm.tm_mon,sttm.tm_mday); 
-    return;
-  }
+  if (XMLNumber(bfound,field,strTemp) == false) return false;
 
-  if (strcmp(fmt,"yyyy-mm") == 0)
-  {
-    snprintf(stime,8,"%04u-%02u",sttm.tm_year,sttm.tm_mon); 
-    return;
-  }
+  (*value) = atof(strTemp); return true;
+}
 
-  if (strcmp(fmt,"yyyymmddhh24miss") == 0)
-  {
-    snprintf(stime,15,"%04u%02u%02u%02u%02u%02u",sttm.tm_year,
-                    sttm.tm_mon,sttm.tm_mday,sttm.tm_hour,
-                    sttm.tm_min,sttm.tm_sec);
-    return;
-  }
+bool GetXMLBuffer(const char *xmlbuffer,const char *fieldname,char *value,const int ilen)
+{
+  string_view field;
 
-  if (strcmp(fmt,"yyyymmddhh24mi") == 0)
-  {
-    snprintf(stime,13,"%04u%02u%02u%02u%02u",sttm.tm_year,
-                    sttm.tm_mon,sttm.tm_mday,sttm.tm_hour,
-                    sttm.tm_min);
-    return;
-  }
+  return XMLValue(FindXMLField(xmlbuffer,fieldname,&field),field,value,ilen);
+}
 
-  if (strcmp(fmt,"yyyymmddhh24") == 0)
-  {
-    snprintf(stime,11,"%04u%02u%02u%02u",sttm.tm_year,
-                    sttm.tm_mon,sttm.tm_mday,sttm.tm_hour);
-    return;
-  }
+bool GetXMLBuffer(const char *xmlbuffer,const char *fieldname,bool *value)
+{
+  string_view field;
 
-  if (strcmp(fmt,"yyyymmdd") == 0)
-  {
-    snprintf(stime,9,"%04u%02u%02u",sttm.tm_year,sttm.tm_mon,sttm.tm_mday); 
-    return;
-  }
+  return XMLValue(FindXMLField(xmlbuffer,fieldname,&field),field,value);
+}
 
-  if (strcmp(fmt,"hh24miss") == 0)
-  {
-    snprintf(stime,7,"%02u%02u%02u",sttm.tm_hour,sttm.tm_min,sttm.tm_sec); 
-    return;
-  }
+bool GetXMLBuffer(const char *xmlbuffer,const char *fieldname,int *value)
+{
+  string_view field;
 
-  if (strcmp(fmt,"hh24mi") == 0)
-  {
-    snprintf(stime,5,"%02u%02u",sttm.tm_hour,sttm.tm_min); 
-    return;
-  }
+  return XMLValue(FindXMLField(xmlbuffer,fieldname,&field),field,value);
+}
 
-  if (strcmp(fmt,"hh24") == 0)
-  {
-    snprintf(stime,3,"%02u",sttm.tm_hour); 
-    return;
-  }
+bool GetXMLBuffer(const char *xmlbuffer,const char *fieldname,unsigned int *value)
+{
+  string_view field;
 
-  if (strcmp(fmt,"mi") == 0)
-  {
-    snprintf(stime,3,"%02u",sttm.tm_min); 
-    return;
-  }
+  return XMLValue(FindXMLField(xmlbuffer,fieldname,&field),field,value);
 }
 
+bool GetXMLBuffer(const char *xmlbuffer,const char *fieldname,long *value)
+{
+  string_view field;
 
-/*
-  取操作系统的时间，并把整数表示的时间转换为字符串表示的格式。
-  stime：用于存放获取到的时间字符串。
-  timetvl：时间的偏移量，单位：秒，0是缺省值，表示当前时间，30表示当前时间30秒之后的时间点，-30表示当前时间30秒之前的时间点。
-  fmt：输出时间的格式，缺省是"yyyy-mm-dd hh24:mi:ss"，目前支持以下格式：
+  return XMLValue(FindXMLField(xmlbuffer,fieldname,&field),field,value);
+}
+
+bool GetXMLBuffer(const char *xmlbuffer,const char *fieldname,unsigned long *value)
+{
+  string_view field;
+
+  return XMLValue(FindXMLField(xmlbuffer,fieldname,&field),field,value);
+}
+
+bool GetXMLBuffer(const char *xmlbuffer,const char *fieldname,double *value)
+{
+  string_view field;
+
+  return XMLValue(FindXMLField(xmlbuffer,fieldname,&field),field,value);
+}
+
+CXMLRecord::CXMLRecord()
+{
+  m_xmlbuffer=0;
+  m_bNested=false;
+}
+
+CXMLRecord::CXMLRecord(const char *xmlbuffer)
+{
+  Parse(xmlbuffer);
+}
+
+// 扫描一条记录，生成字段的索引，返回字段的个数。
+int CXMLRecord::Parse(const char *xmlbuffer)
+{
+  m_xmlbuffer=xmlbuffer;
+  m_bNested=false;
+  m_vfields.clear();
+
+  if (xmlbuffer==0) return 0;
+
+  const char *pos=xmlbuffer;
+
+  while ( (pos=strchr(pos,'<')) != 0)
+  {
+    // 标签名到'>'为止，如果中间又出现了'<'，从新的'<'开始。
+    const char *namebeg=pos+1;
+    const char *nameend=strpbrk(namebeg,"<>");
+
+    if (nameend==0) break;
+
+    if (*nameend=='<') { pos=nameend; continue; }
+
+    // 结束标签、<endl/>之类的空标签和空的标签名不索引。
+    if ( (nameend==namebeg) || (*namebeg=='/') || (*(nameend-1)=='/') ) { pos=nameend+1; continue; }
+
+    size_t namelen=nameend-namebeg;
+
+    // 查找结束标签</name>。
+    const char *valbeg=nameend+1;
+    const char *end=valbeg;
+
+    while ( (end=strchr(end,'<')) != 0)
+    {
+      if ( (end[1]=='/') && (strncmp(end+2,namebeg,namelen)==0) && (end[namelen+2]=='>') ) break;
+      end++;
+    }
+
+    // 没有结束标签，从标签之后继续扫描。
+    if (end==0) { pos=valbeg; continue; }
+
+    m_vfields.push_back({string_view(namebeg,namelen),string_view(valbeg,end-valbeg)});
+
+    // 字段的内容中有标签，嵌套的字段没有索引，获取字段时需要从记录中查找。
+    if (memchr(valbeg,'<',end-valbeg) != 0) m_bNested=true;
+
+    pos=end+namelen+3;
+  }
+
+  return m_vfields.size();
+}
+
+// 获取字段的内容，不复制字符串。
+bool CXMLRecord::Find(const char *fieldname,string_view &value) const
+{
+  if ( (m_xmlbuffer==0) || (fieldname==0) ) return false;    // 判断空指针。
+
+  // 有嵌套的字段时，第一次出现的标签可能在其它字段的内容中，按GetXMLBuffer函数的规则从记录中查找。
+  if (m_bNested==true) return FindXMLField(m_xmlbuffer,fieldname,&value);
+
+  string_view name(fieldname);
+
+  for (auto &field : m_vfields)
+  {
+    if (field.name==name) { value=field.value; return true; }
+  }
+
+  return false;
+}
+
+bool CXMLRecord::GetValue(const char *fieldname,char *value,const int ilen) const
+{
+  string_view field;
+
+  return XMLValue(Find(fieldname,field),field,value,ilen);
+}
+
+bool CXMLRecord::GetValue(const char *fieldname,bool *value) const
+{
+  string_view field;
+
+  return XMLValue(Find(fieldname,field),field,value);
+}
+
+bool CXMLRecord::GetValue(const char *fieldname,int *value) const
+{
+  string_view field;
+
+  return XMLValue(Find(fieldname,field),field,value);
+}
+
+bool CXMLRecord::GetValue(const char *fieldname,unsigned int *value) const
+{
+  string_view field;
+
+  return XMLValue(Find(fieldname,field),field,value);
+}
+
+bool CXMLRecord::GetValue(const char *fieldname,long *value) const
+{
+  string_view field;
+
+  return XMLValue(Find(fieldname,field),field,value);
+}
+
+bool CXMLRecord::GetValue(const char *fieldname,unsigned long *value) const
+{
+  string_view field;
+
+  return XMLValue(Find(fieldname,field),field,value);
+}
+
+bool CXMLRecord::GetValue(const char *fieldname,double *value) const
+{
+  string_view field;
+
+  return XMLValue(Find(fieldname,field),field,value);
+}
+
+bool CXMLRecord::GetValue(const char *fieldname,string_view *value) const
+{
+  if (value==0) return false;    // 判断空指针。
+
+  string_view field;
+
+  if (Find(fieldname,field) == false) { (*value)=string_view(); return false; }
+
+  (*value)=TrimSpace(field);
+
+  return true;
+}
+
+CStrBuilder::CStrBuilder(const int format,const size_t capacity)
+{
+  m_buffer.resize(capacity+1);
+  m_len=0;
+
+  SetFormat(format);
+}
+
+// 设置格式，设置格式会清空已生成的内容。
+void CStrBuilder::SetFormat(const int format,const char sep)
+{
+  m_format=format;
+  m_sep=sep;
+
+  Clear();
+}
+
+// 清空已生成的内容和记录数，已分配的内存保留。
+void CStrBuilder::Clear()
+{
+  ClearBuffer();
+
+  m_fieldcount=0;
+  m_recordcount=0;
+}
+
+// 只清空已生成的内容，记录数不变。
+void CStrBuilder::ClearBuffer()
+{
+  m_len=0;
+  m_buffer[0]=0;
+}
+
+// 预先分配缓冲区。
+void CStrBuilder::Reserve(const size_t capacity)
+{
+  if (capacity+1>m_buffer.size()) m_buffer.resize(capacity+1);
+}
+
+// 确保内容之后还有n+1字节的空间，返回写入的位置。
+char *CStrBuilder::Grow(const size_t n)
+{
+  if (m_len+n+1>m_buffer.size()) m_buffer.resize(max(m_buffer.size()*2,m_len+n+1));
+
+  return &m_buffer[m_len];
+}
+
+// 调整内容的长度，并在结尾补0。
+void CStrBuilder::Commit(const size_t n)
+{
+  m_len=m_len+n;
+  m_buffer[m_len]=0;
+}
+
+// 追加len字节的内容。
+void CStrBuilder::Put(const char *str,const size_t len)
+{
+  memcpy(Grow(len),str,len);
+
+  Commit(len);
+}
+
+// 开始一条记录。
+void CStrBuilder::BeginRecord()
+{
+  if (m_format==STRB_JSON)
+  {
+    if (m_recordcount>0) Put(",{",2);
+    else Put("{",1);
+  }
+
+  m_fieldcount=0;
+}
+
+// 结束一条记录。
+void CStrBuilder::EndRecord()
+{
+  switch (m_format)
+  {
+    case STRB_XML:  Put("<endl/>\n",8); break;
+    case STRB_JSON: Put("}",1); break;
+    case STRB_CSV:  Put("\n",1); break;
+  }
+
+  m_recordcount++;
+  m_fieldcount=0;
+}
+
+// 在pos写入字段内容之前的部分，例如<name>、,"name":"，返回写入后的位置，调用者保证空间足够（namelen+6字节）。
+char *CStrBuilder::FieldPrefix(char *pos,const char *name,const size_t namelen)
+{
+  switch (m_format)
+  {
+    case STRB_XML:
+      *pos++='<';
+      memcpy(pos,name,namelen); pos=pos+namelen;
+      *pos++='>';
+      break;
+    case STRB_JSON:
+      if (m_fieldcount>0) *pos++=',';
+      *pos++='"';
+      memcpy(pos,name,namelen); pos=pos+namelen;
+      *pos++='"'; *pos++=':'; *pos++='"';
+      break;
+    case STRB_CSV:
+      if (m_fieldcount>0) *pos++=m_sep;
+      break;
+  }
+
+  m_fieldcount++;
+
+  return pos;
+}
+
+// 在pos写入字段内容之后的部分，例如</name>、"，返回写入后的位置，调用者保证空间足够（namelen+3字节）。
+char *CStrBuilder::FieldSuffix(char *pos,const char *name,const size_t namelen)
+{
+  if (m_format==STRB_XML)
+  {
+    *pos++='<'; *pos++='/';
+    memcpy(pos,name,namelen); pos=pos+namelen;
+    *pos++='>';
+  }
+
+  if (m_format==STRB_JSON) *pos++='"';
+
+  return pos;
+}
+
+// 写入字段的内容，json格式转义双引号、反斜杠和控制字符，没有需要转义的字符时整段追加。
+void CStrBuilder::AppendValue(string_view value)
+{
+  if (m_format!=STRB_JSON) { Put(value.data(),value.size()); return; }
+
+  size_t ibeg=0;
+
+  for (size_t ii=0;ii<value.size();ii++)
+  {
+    unsigned char chr=value[ii];
+
+    if ( (chr!='"') && (chr!='\\') && (chr>=0x20) ) continue;
+
+    Put(value.data()+ibeg,ii-ibeg);
+
+    switch (chr)
+    {
+      case '"':  Put("\\\"",2); break;
+      case '\\': Put("\\\\",2); break;
+      case '\n': Put("\\n",2);  break;
+      case '\r': Put("\\r",2);  break;
+      case '\t': Put("\\t",2);  break;
+      default:
+        Commit(snprintf(Grow(6),7,"\\u%04x",chr));
+    }
+
+    ibeg=ii+1;
+  }
+
+  Put(value.data()+ibeg,value.size()-ibeg);
+}
+
+void CStrBuilder::AddField(const char *name,const char *value)
+{
+  AddField(name,string_view( (value==0)?"":value ));
+}
+
+void CStrBuilder::AddField(const char *name,string_view value)
+{
+  size_t namelen=strlen(name);
+
+  char *pos=Grow(namelen+6);
+  Commit(FieldPrefix(pos,name,namelen)-pos);
+
+  AppendValue(value);
+
+  pos=Grow(namelen+3);
+  Commit(FieldSuffix(pos,name,namelen)-pos);
+}
+
+void CStrBuilder::AddField(const char *name,const int value)
+{
+  AddField(name,(long)value);
+}
+
+// 整数直接转换到缓冲区的末尾。
+void CStrBuilder::AddField(const char *name,const long value)
+{
+  size_t namelen=strlen(name);
+
+  // 字段名、内容和结束标签一次预留空间，连续写入。
+  char *beg=Grow(namelen*2+30);
+  char *pos=FieldPrefix(beg,name,namelen);
+  pos=pos+FormatInt(pos,value);
+  pos=FieldSuffix(pos,name,namelen);
+
+  Commit(pos-beg);
+}
+
+void CStrBuilder::AddField(const char *name,const double value,const int digits)
+{
+  size_t namelen=strlen(name);
+
+  char *pos=Grow(namelen+6);
+  Commit(FieldPrefix(pos,name,namelen)-pos);
+
+  // 先预留64字节，很大的数超过了64字节，再按实际的长度转换一次。
+  int ilen=snprintf(Grow(64),65,"%.*f",digits,value);
+
+  if (ilen>64) snprintf(Grow(ilen),ilen+1,"%.*f",digits,value);
+
+  Commit(ilen);
+
+  pos=Grow(namelen+3);
+  Commit(FieldSuffix(pos,name,namelen)-pos);
+}
+
+void CStrBuilder::AddTenths(const char *name,const long value)
+{
+  size_t namelen=strlen(name);
+
+  char *beg=Grow(namelen*2+31);
+  char *pos=FieldPrefix(beg,name,namelen);
+  pos=pos+FormatTenths(pos,value);
+  pos=FieldSuffix(pos,name,namelen);
+
+  Commit(pos-beg);
+}
+
+// 原样追加内容。
+void CStrBuilder::Append(string_view str)
+{
+  Put(str.data(),str.size());
+}
+
+void CStrBuilder::AppendChar(const char chr)
+{
+  *Grow(1)=chr;
+
+  Commit(1);
+}
+
+// 时间转换的缓存，每个线程一份，不需要加锁。
+// hourbeg是缓存的整点时间，[winbeg,hourbeg+3600)内的时间只有分和秒不同，用整数运算得到，不调用localtime_r。
+// ltime、fmt和stime是最近一次转换的结果，同一秒内用相同的格式再次转换时直接复制，不重新格式化。
+struct st_timecache
+{
+  time_t    hourbeg;      // 缓存的整点时间，-1表示还没有缓存。
+  time_t    winbeg;       // 缓存生效的起始时间，是这个小时内转换过的最早的时间。
+  struct tm sttm;         // hourbeg对应的本地时间。
+  time_t    ltime;        // 最近一次转换的时间，-1表示还没有缓存。
+  char      fmt[25];      // 最近一次转换的格式。
+  char      stime[21];    // 最近一次转换的结果。
+};
+
+static thread_local struct st_timecache timecache={-1,-1,{},-1,"",""};
+
+// 把整数表示的时间转换为本地时间，与localtime_r相同，但同一个小时内一般只调用一次localtime_r。
+// 夏令时的切换不一定在本地时间的整点（例如半小时的夏令时），所以缓存不从整点开始生效，
+// 而是从转换过的最早的时间开始，两个时间的小时和时区偏移都相同，它们之间就不会有夏令时的切换。
+static void LocalTm(const time_t ltime,struct tm *sttm)
+{
+  if ( (timecache.hourbeg!=-1) && (ltime>=timecache.winbeg) && (ltime<timecache.hourbeg+3600) )
+  {
+    (*sttm)=timecache.sttm;
+    sttm->tm_min=(ltime-timecache.hourbeg)/60;
+    sttm->tm_sec=(ltime-timecache.hourbeg)%60;
+    return;
+  }
+
+  localtime_r(&ltime,sttm);
+
+  time_t hourbeg=ltime-sttm->tm_min*60-sttm->tm_sec;
+
+  // 同一个小时内更早的时间，只需要扩大缓存的范围。
+  if ( (hourbeg==timecache.hourbeg) && (sttm->tm_gmtoff==timecache.sttm.tm_gmtoff) && (ltime<timecache.winbeg) )
+  {
+    timecache.winbeg=ltime; return;
+  }
+
+  timecache.hourbeg=hourbeg;
+  timecache.winbeg=ltime;
+  timecache.sttm=(*sttm);
+}
+
+// 写入两位数字，不足两位在前面补0。
+static char *FormatDigits2(char *pos,const int value)
+{
+  pos[0]='0'+value/10%10; pos[1]='0'+value%10;
+
+  return pos+2;
+}
+
+// 按fmt格式把本地时间写入stime，不调用snprintf和strftime。
+// fmt中的yyyy、mm、dd、hh24、mi和ss替换为年、月、日、时、分和秒，其它的字符原样写入。
+// 返回值：fmt是支持的格式返回true，否则stime为空，返回false。
+static bool FormatTime(const struct tm *sttm,char *stime,const char *fmt)
+{
+  // 支持的格式，与LocalTime函数的说明相同。
+  static const char *fmts[]={"yyyy-mm-dd hh24:mi:ss","yyyy-mm-dd hh24:mi","yyyy-mm-dd hh24","yyyy-mm-dd","yyyy-mm",
+                             "yyyymmddhh24miss","yyyymmddhh24mi","yyyymmddhh24","yyyymmdd",
+                             "hh24:mi:ss","hh24:mi","hh24miss","hh24mi","hh24","mi"};
+
+  stime[0]=0;
+
+  bool bfound=false;
+  for (unsigned int ii=0;ii<sizeof(fmts)/sizeof(fmts[0]);ii++)
+  {
+    if (strcmp(fmt,fmts[ii])==0) { bfound=true; break; }
+  }
+  if (bfound==false) return false;
+
+  char *pos=stime;
+
+  while (*fmt!=0)
+  {
+    if (strncmp(fmt,"yyyy",4)==0)
+    {
+      int year=sttm->tm_year+1900;
+      pos=FormatDigits2(pos,year/100); pos=FormatDigits2(pos,year%100); fmt=fmt+4; continue;
+    }
+    if (strncmp(fmt,"hh24",4)==0) { pos=FormatDigits2(pos,sttm->tm_hour);  fmt=fmt+4; continue; }
+    if (strncmp(fmt,"mm",2)==0)   { pos=FormatDigits2(pos,sttm->tm_mon+1); fmt=fmt+2; continue; }
+    if (strncmp(fmt,"dd",2)==0)   { pos=FormatDigits2(pos,sttm->tm_mday);  fmt=fmt+2; continue; }
+    if (strncmp(fmt,"mi",2)==0)   { pos=FormatDigits2(pos,sttm->tm_min);   fmt=fmt+2; continue; }
+    if (strncmp(fmt,"ss",2)==0)   { pos=FormatDigits2(pos,sttm->tm_sec);   fmt=fmt+2; continue; }
+
+    *pos++=*fmt++;
+  }
+
+  *pos=0;
+
+  return true;
+}
+
+// 把整数表示的时间转换为字符串表示的时间。
+// ltime：整数表示的时间。
+// stime：字符串表示的时间。
+// fmt：输出字符串时间stime的格式，与LocalTime函数的fmt参数相同，如果fmt的格式不正确，stime将为空。
+// 本函数是线程安全的，同一秒内用相同的格式多次转换只格式化一次。
+void timetostr(const time_t ltime,char *stime,const char *fmt)
+{
+  if (stime==0) return;    // 判断空指针。
+
+  if (fmt==0) fmt="yyyy-mm-dd hh24:mi:ss";
+
+  if ( (ltime==timecache.ltime) && (strcmp(fmt,timecache.fmt)==0) )
+  {
+    strcpy(stime,timecache.stime); return;
+  }
+
+  struct tm sttm;
+  LocalTm(ltime,&sttm);
+
+  if (FormatTime(&sttm,stime,fmt)==false) return;
+
+  // 格式都不超过24个字符，结果都不超过20个字符。
+  timecache.ltime=ltime;
+  strcpy(timecache.fmt,fmt);
+  strcpy(timecache.stime,stime);
+}
+
+
+/*
+  取操作系统的时间，并把整数表示的时间转换为字符串表示的格式。
+  stime：用于存放获取到的时间字符串。
+  timetvl：时间的偏移量，单位：秒，0是缺省值，表示当前时间，30表示当前时间30秒之后的时间点，-30表示当前时间30秒之前的时间点。
+  fmt：输出时间的格式，缺省是"yyyy-mm-dd hh24:mi:ss"，目前支持以下格式：
   "yyyy-mm-dd hh24:mi:ss"，此格式是缺省格式。
   "yyyymmddhh24miss"
   "yyyy-mm-dd"
@@ -1095,14 +2159,14 @@ CLogFile::CLogFile(const long MaxLogSize)
   m_MaxLogSize=MaxLogSize;
   if (m_MaxLogSize<10) m_MaxLogSize=10;
 
-  // pthread_pin_init(&spin,0);  // 初学暂时不要关心这行代码。
+  pthread_spin_init(&spin,0);  // 多线程写日志时用于加锁。
 }
 
 CLogFile::~CLogFile()
 {
   Close();
 
-  // pthread_spin_destroy(&spin);  // 初学暂时不要关心这行代码。
+  pthread_spin_destroy(&spin);
 }
 
 void CLogFile::Close()
@@ -1172,9 +2236,9 @@ bool CLogFile::Write(const char *fmt,...)
 {
   if (m_tracefp == 0) return false;
 
-  // pthread_spin_lock(&spin);  // 初学暂时不要关心这行代码。
+  pthread_spin_lock(&spin);  // 加锁，防止多个线程的日志内容交错。
 
-  if (BackupLogFile() == false) return false;
+  if (BackupLogFile() == false) { pthread_spin_unlock(&spin); return false; }
 
   char strtime[20]; LocalTime(strtime);
   va_list ap;
@@ -1185,7 +2249,7 @@ bool CLogFile::Write(const char *fmt,...)
 
   if (m_bEnBuffer==false) fflush(m_tracefp);
 
-  // pthread_spin_unlock(&spin);  // 初学暂时不要关心这行代码。
+  pthread_spin_unlock(&spin);
 
   return true;
 }
@@ -1196,7 +2260,7 @@ bool CLogFile::WriteEx(const char *fmt,...)
 {
   if (m_tracefp == 0) return false;
 
-  // pthread_spin_lock(&spin);  // 初学暂时不要关心这行代码。
+  pthread_spin_lock(&spin);
 
   va_list ap;
   va_start(ap,fmt);
@@ -1205,73 +2269,288 @@ bool CLogFile::WriteEx(const char *fmt,...)
 
   if (m_bEnBuffer==false) fflush(m_tracefp);
 
-  // pthread_spin_unlock(&spin);  // 初学暂时不要关心这行代码。
+  pthread_spin_unlock(&spin);
 
   return true;
 }
 
+volatile sig_atomic_t CIniFile::m_sighupcount=0;
+
 CIniFile::CIniFile()
 {
-  
+  m_bReload=false;
+  m_checktvl=5;
+  m_nextcheck=0;
+  m_mtime=0;
+  m_sighupseq=0;
 }
 
-bool CIniFile::LoadFile(const char *filename)
+// SIGHUP信号的处理函数，只累加计数，由GetValue方法检查后重新加载。
+void CIniFile::SighupHandler(int)
 {
-  m_xmlbuffer.clear();
+  m_sighupcount=m_sighupcount+1;
+}
 
-  CFile File;
+// 把文件的全部内容一次读入buffer中，mtime存放文件的修改时间，CIniFile的参数文件和CDirSnapshot的快照文件都用它读取。
+static bool ReadWholeFile(const char *filename,string &buffer,time_t &mtime)
+{
+  int fd=open(filename,O_RDONLY);
 
-  if ( File.Open(filename,"r") == false) return false;
+  if (fd<0) return false;
 
-  char strLine[501];
+  struct stat st_filestat;
 
-  while (true)
+  if (fstat(fd,&st_filestat) != 0) { close(fd); return false; }
+
+  buffer.resize(st_filestat.st_size);
+
+  size_t total=0;
+  ssize_t ret=0;
+
+  while ( (total<buffer.size()) && ( (ret=read(fd,&buffer[total],buffer.size()-total)) > 0 ) ) total=total+ret;
+
+  close(fd);
+
+  if (ret<0) return false;
+
+  buffer.resize(total);     // 读取期间文件可能被截短。
+
+  mtime=st_filestat.st_mtime;
+
+  return true;
+}
+
+bool CIniFile::LoadFile(const char *filename)
+{
+  m_filename=filename;
+
+  if (Reload() == true) return true;
+
+  m_xmlbuffer.clear();
+  m_content.clear();
+  m_values.clear();
+
+  return false;
+}
+
+// 立即重新加载参数文件，如果加载失败，保留原来的参数。
+bool CIniFile::Reload()
+{
+  if (m_filename.empty() == true) return false;
+
+  m_nextcheck=time(0)+m_checktvl;
+
+  string strcontent;
+  time_t mtime=0;
+
+  if (ReadWholeFile(m_filename.c_str(),strcontent,mtime) == false) return false;
+
+  if (strcontent.length() < 10) return false;
+
+  m_xmlbuffer=strcontent;
+  m_content.swap(strcontent);
+  m_mtime=mtime;
+
+  Parse();
+
+  return true;
+}
+
+// 解析m_content，生成参数的哈希表。
+// 每个'<'都作为标签的开始，查找它的结束标签，不跳过标签的内容，所以嵌套的标签也能找到。
+void CIniFile::Parse()
+{
+  m_values.clear();
+
+  const char *pos=m_content.c_str();
+
+  while ( (pos=strchr(pos,'<')) != 0 )
   {
-    memset(strLine,0,sizeof(strLine));
+    const char *namebeg=pos+1;
+    const char *nameend=strpbrk(namebeg,"<>");
+
+    if (nameend==0) break;
+
+    pos=namebeg;
+
+    // 结束标签和空的标签名不是参数。
+    if ( (*nameend=='<') || (nameend==namebeg) || (*namebeg=='/') ) continue;
+
+    string_view name(namebeg,nameend-namebeg);
+
+    // 同名的标签取第一个，与GetXMLBuffer函数相同。
+    if (m_values.find(name) != m_values.end()) continue;
+
+    // 查找结束标签</name>。
+    size_t namelen=name.size();
+    const char *end=nameend+1;
+
+    while ( (end=strchr(end,'<')) != 0)
+    {
+      if ( (end[1]=='/') && (strncmp(end+2,namebeg,namelen)==0) && (end[namelen+2]=='>') ) break;
+      end++;
+    }
+
+    if (end==0) continue;
+
+    // 数值类型的内容预先转换好，转换的规则与GetXMLBuffer函数相同。
+    struct st_inivalue stvalue;
+
+    stvalue.value=string_view(nameend+1,end-nameend-1);
+    XMLValue(true,stvalue.value,&stvalue.lvalue);
+    XMLValue(true,stvalue.value,&stvalue.dvalue);
+    XMLValue(true,stvalue.value,&stvalue.bvalue);
+
+    m_values.emplace(name,stvalue);
+  }
+}
+
+// 开启自动重新加载。
+void CIniFile::EnableReload(const int checktvl,const bool bsighup)
+{
+  m_bReload=true;
+  m_checktvl=checktvl;
+  m_nextcheck=time(0)+m_checktvl;
+  m_sighupseq=m_sighupcount;
 
-    if (File.FFGETS(strLine,500) == false) break;
+  if (bsighup == true) signal(SIGHUP,SighupHandler);
+}
+
+// 开启了自动重新加载时，检查是否需要重新加载参数文件。
+// 平时只比较SIGHUP信号的计数和当前时间，到了检查的时间才调用stat。
+void CIniFile::CheckReload()
+{
+  if (m_bReload == false) return;
 
-    m_xmlbuffer=m_xmlbuffer+strLine;
+  if (m_sighupseq != m_sighupcount)
+  {
+    m_sighupseq=m_sighupcount; Reload(); return;
   }
 
-  if (m_xmlbuffer.length() < 10) return false;
+  time_t now=time(0);
 
-  return true;
+  if (now < m_nextcheck) return;
+
+  m_nextcheck=now+m_checktvl;
+
+  struct stat st_filestat;
+
+  if (stat(m_filename.c_str(),&st_filestat) != 0) return;
+
+  if (st_filestat.st_mtime != m_mtime) Reload();
+}
+
+// 查找参数，返回值：参数的内容，参数不存在时返回0。
+const struct CIniFile::st_inivalue *CIniFile::Find(const char *fieldname)
+{
+  CheckReload();
+
+  if (fieldname==0) return 0;
+
+  auto it=m_values.find(string_view(fieldname));
+
+  if (it == m_values.end()) return 0;
+
+  return &it->second;
 }
 
 bool CIniFile::GetValue(const char *fieldname,bool   *value)
 {
-  return GetXMLBuffer(m_xmlbuffer.c_str(),fieldname,value);
+  if (value==0) return false;    // 判断空指针。
+
+  const struct st_inivalue *stvalue=Find(fieldname);
+
+  (*value)=false;
+
+  if (stvalue==0) return false;
+
+  (*value)=stvalue->bvalue;
+
+  return stvalue->bvalue;
 }
 
 bool CIniFile::GetValue(const char *fieldname,char *value,int ilen)
 {
-  return GetXMLBuffer(m_xmlbuffer.c_str(),fieldname,value,ilen);
+  const struct st_inivalue *stvalue=Find(fieldname);
+
+  if (stvalue==0) return XMLValue(false,string_view(),value,ilen);
+
+  return XMLValue(true,stvalue->value,value,ilen);
 }
 
 bool CIniFile::GetValue(const char *fieldname,int *value)
 {
-  return GetXMLBuffer(m_xmlbuffer.c_str(),fieldname,value);
+  if (value==0) return false;    // 判断空指针。
+
+  const struct st_inivalue *stvalue=Find(fieldname);
+
+  (*value)=0;
+
+  if (stvalue==0) return false;
+
+  (*value)=(int)stvalue->lvalue;    // 与atoi函数相同。
+
+  return true;
 }
 
 bool CIniFile::GetValue(const char *fieldname,unsigned int *value)
 {
-  return GetXMLBuffer(m_xmlbuffer.c_str(),fieldname,value);
+  if (value==0) return false;    // 判断空指针。
+
+  const struct st_inivalue *stvalue=Find(fieldname);
+
+  (*value)=0;
+
+  if (stvalue==0) return false;
+
+  (*value)=(unsigned int)(int)stvalue->lvalue;
+
+  return true;
 }
 
 bool CIniFile::GetValue(const char *fieldname,long *value)
 {
-  return GetXMLBuffer(m_xmlbuffer.c_str(),fieldname,value);
+  if (value==0) return false;    // 判断空指针。
+
+  const struct st_inivalue *stvalue=Find(fieldname);
+
+  (*value)=0;
+
+  if (stvalue==0) return false;
+
+  (*value)=stvalue->lvalue;
+
+  return true;
 }
 
 bool CIniFile::GetValue(const char *fieldname,unsigned long *value)
 {
-  return GetXMLBuffer(m_xmlbuffer.c_str(),fieldname,value);
+  if (value==0) return false;    // 判断空指针。
+
+  const struct st_inivalue *stvalue=Find(fieldname);
+
+  (*value)=0;
+
+  if (stvalue==0) return false;
+
+  (*value)=(unsigned long)stvalue->lvalue;
+
+  return true;
 }
 
 bool CIniFile::GetValue(const char *fieldname,double *value)
 {
-  return GetXMLBuffer(m_xmlbuffer.c_str(),fieldname,value);
+  if (value==0) return false;    // 判断空指针。
+
+  const struct st_inivalue *stvalue=Find(fieldname);
+
+  (*value)=0;
+
+  if (stvalue==0) return false;
+
+  (*value)=stvalue->dvalue;
+
+  return true;
 }
 
 // 关闭全部的信号和输入输出
@@ -1358,42 +2637,212 @@ bool UTime(const char *filename,const char *mtime)
   return true;
 }
 
+// 从1970-01-01到公历y年m月d日的天数，y年m月已经规范化，m的取值是1-12，d可以超出当月的天数。
+// 纯整数运算，与时区无关，算法见Howard Hinnant的days_from_civil。
+static long DaysFromCivil(long y,const long m,const long d)
+{
+  y=y-(m<=2);
+  long era=(y>=0?y:y-399)/400;
+  long yoe=y-era*400;
+  long doy=(153*(m>2?m-3:m+9)+2)/5+d-1;
+  long doe=yoe*365+yoe/4-yoe/100+doy;
+
+  return era*146097+doe-719468;
+}
+
+// 从1970-01-01开始的天数转换为公历的年月日，是DaysFromCivil的逆运算。
+static void CivilFromDays(long z,int *y,int *m,int *d)
+{
+  z=z+719468;
+  long era=(z>=0?z:z-146096)/146097;
+  long doe=z-era*146097;
+  long yoe=(doe-doe/1460+doe/36524-doe/146096)/365;
+  long doy=doe-(365*yoe+yoe/4-yoe/100);
+  long mp=(5*doy+2)/153;
+
+  (*d)=doy-(153*mp+2)/5+1;
+  (*m)=mp<10?mp+3:mp-9;
+  (*y)=yoe+era*400+((*m)<=2);
+}
+
+// 时区偏移的缓存，每个线程一份，不需要加锁，按天直接映射，day是从1970-01-01开始的天数。
+// 当天的开始和结束用mktime算出的时区偏移相同，这一天的时间都用这个偏移换算，不再调用mktime；
+// 不同说明这一天有夏令时的切换，bsame为false，这一天的时间仍调用mktime。
+struct st_tzcache
+{
+  long day;       // 缓存的日期，-1表示还没有缓存。
+  long offset;    // 本地时间与UTC时间的差，单位：秒。
+  bool bsame;     // 当天的开始和结束的时区偏移是否相同。
+};
+
+#define TZCACHESIZE 64
+static thread_local struct st_tzcache tzcache[TZCACHESIZE]={{-1,0,false}};
+
+// 用mktime把本地时间转换为整数表示的时间，civil是把本地时间当成UTC时间算出的秒数。
+// 与原来的strtotime相同，tm_isdst取0。
+static time_t CivilMktime(const long civil)
+{
+  struct tm sttm;
+  memset(&sttm,0,sizeof(sttm));
+
+  long day=civil>=0?civil/86400:(civil-86399)/86400;
+  long secs=civil-day*86400;
+
+  CivilFromDays(day,&sttm.tm_year,&sttm.tm_mon,&sttm.tm_mday);
+  sttm.tm_year=sttm.tm_year-1900;
+  sttm.tm_mon=sttm.tm_mon-1;
+  sttm.tm_hour=secs/3600;
+  sttm.tm_min=secs%3600/60;
+  sttm.tm_sec=secs%60;
+  sttm.tm_isdst=0;
+
+  return mktime(&sttm);
+}
+
+// 获取day这一天的时区偏移的缓存，没有缓存时先用mktime算出来。
+static struct st_tzcache *DayTzCache(const long day)
+{
+  struct st_tzcache *cache=&tzcache[(unsigned long)day%TZCACHESIZE];
+
+  if (cache->day!=day)
+  {
+    long daybeg=day*86400;
+    time_t tbeg=CivilMktime(daybeg);
+    time_t tend=CivilMktime(daybeg+86399);
+
+    cache->day=day;
+    cache->offset=daybeg-tbeg;
+    cache->bsame=( (daybeg+86399-tend)==cache->offset );
+  }
+
+  return cache;
+}
+
+// 把本地时间转换为整数表示的时间，civil是把本地时间当成UTC时间算出的秒数。
+static time_t CivilToTime(const long civil)
+{
+  long day=civil>=0?civil/86400:(civil-86399)/86400;
+
+  struct st_tzcache *cache=DayTzCache(day);
+
+  if (cache->bsame==false) return CivilMktime(civil);
+
+  return civil-cache->offset;
+}
+
 // 把字符串表示的时间转换为整数表示的时间。
 // stime：字符串表示的时间，格式不限，但一定要包括yyyymmddhh24miss，一个都不能少。
 // 返回值：整数表示的时间，如果stime的格式不正确，返回-1。
+// 只取stime中的数字，年月日时分秒直接用整数运算换算，时区偏移按天缓存，一般不调用mktime。
 time_t strtotime(const char *stime)
 {
-  char strtime[21],yyyy[5],mm[3],dd[3],hh[3],mi[3],ss[3];
-  memset(strtime,0,sizeof(strtime));
-  memset(yyyy,0,sizeof(yyyy));
-  memset(mm,0,sizeof(mm));
-  memset(dd,0,sizeof(dd));
-  memset(hh,0,sizeof(hh));
-  memset(mi,0,sizeof(mi));
-  memset(ss,0,sizeof(ss));
+  if (stime==0) return -1;    // 判断空指针。
+
+  // 取出stime中的数字，必须正好是14个。
+  int digits[14];
+  int count=0;
+
+  for (const char *pos=stime;*pos!=0;pos++)
+  {
+    if ( (*pos<'0') || (*pos>'9') ) continue;
+
+    if (count==14) return -1;
+
+    digits[count++]=*pos-'0';
+  }
+
+  if (count != 14) return -1;
+
+  long yyyy=digits[0]*1000+digits[1]*100+digits[2]*10+digits[3];
+  long mm=digits[4]*10+digits[5];
+  long dd=digits[6]*10+digits[7];
+  long hh=digits[8]*10+digits[9];
+  long mi=digits[10]*10+digits[11];
+  long ss=digits[12]*10+digits[13];
+
+  // 与mktime相同，月份超出1-12时换算到前后的年份，日、时、分和秒超出范围时顺延。
+  long mon=mm-1;
+  yyyy=yyyy+(mon>=0?mon/12:(mon-11)/12);
+  mon=mon-(mon>=0?mon/12:(mon-11)/12)*12;
+
+  long civil=(DaysFromCivil(yyyy,mon+1,1)+dd-1)*86400+hh*3600+mi*60+ss;
+
+  return CivilToTime(civil);
+}
+
+// 如果stime正好是14位数字（yyyymmddhh24miss）并且时分秒没有超出当天的范围，返回当天的秒数，否则返回-1。
+static long SecsOfDay14(const char *stime)
+{
+  for (int ii=0;ii<14;ii++)
+  {
+    if ( (stime[ii]<'0') || (stime[ii]>'9') ) return -1;
+  }
+
+  if (stime[14]!=0) return -1;
+
+  long hh=(stime[8]-'0')*10+stime[9]-'0';
+  long mi=(stime[10]-'0')*10+stime[11]-'0';
+  long ss=(stime[12]-'0')*10+stime[13]-'0';
+
+  if ( (hh>23) || (mi>59) || (ss>59) ) return -1;
+
+  return hh*3600+mi*60+ss;
+}
+
+// 把多个字符串表示的时间转换为整数表示的时间，与逐个调用strtotime的结果相同。
+// stimes：字符串表示的时间的数组。
+// ltimes：用于存放整数表示的时间的数组，格式不正确的时间为-1。
+// count：时间的个数。
+// 返回值：转换成功的个数。
+// 同一批时间一般是同一天的（例如同一个数据文件中的观测时间），格式为yyyymmddhh24miss的时间与上一个时间的
+// 日期相同时，直接用上一个时间算出的当天开始的时间加上时分秒，不再换算日期，也不再查找时区偏移的缓存。
+int strtotime(const char *const stimes[],time_t ltimes[],const int count)
+{
+  int iok=0;
+
+  const char *prevtime=0;   // 上一个可以复用日期的时间，为空表示没有。
+  time_t daybase=0;         // prevtime那一天开始的时间，即00:00:00的整数表示。
+
+  for (int ii=0;ii<count;ii++)
+  {
+    const char *stime=stimes[ii];
+    long secs=(stime==0) ? -1 : SecsOfDay14(stime);
 
-  PickNumber(stime,strtime,false,false);
+    // 日期与上一个时间相同。
+    if ( (secs>=0) && (prevtime!=0) && (strncmp(stime,prevtime,8)==0) )
+    {
+      ltimes[ii]=daybase+secs; iok++; continue;
+    }
+
+    prevtime=0;
+
+    if (secs>=0)
+    {
+      long yyyy=(stime[0]-'0')*1000+(stime[1]-'0')*100+(stime[2]-'0')*10+stime[3]-'0';
+      long mon=(stime[4]-'0')*10+stime[5]-'0'-1;
+      long dd=(stime[6]-'0')*10+stime[7]-'0';
+
+      // 与strtotime相同，月份超出1-12时换算到前后的年份，日超出范围时顺延。
+      yyyy=yyyy+(mon>=0?mon/12:(mon-11)/12);
+      mon=mon-(mon>=0?mon/12:(mon-11)/12)*12;
 
-  if (strlen(strtime) != 14) return -1;
+      long day=DaysFromCivil(yyyy,mon+1,1)+dd-1;
+      struct st_tzcache *cache=DayTzCache(day);
 
-  strncpy(yyyy,strtime,4);
-  strncpy(mm,strtime+4,2);
-  strncpy(dd,strtime+6,2);
-  strncpy(hh,strtime+8,2);
-  strncpy(mi,strtime+10,2);
-  strncpy(ss,strtime+12,2);
+      // 这一天没有夏令时的切换，当天的时间都可以用同一个时区偏移换算。
+      if (cache->bsame==true)
+      {
+        prevtime=stime; daybase=day*86400-cache->offset;
+        ltimes[ii]=daybase+secs; iok++; continue;
+      }
+    }
 
-  struct tm time_str;
+    ltimes[ii]=strtotime(stime);
 
-  time_str.tm_year = atoi(yyyy) - 1900;
-  time_str.tm_mon = atoi(mm) - 1;
-  time_str.tm_mday = atoi(dd);
-  time_str.tm_hour = atoi(hh);
-  time_str.tm_min = atoi(mi);
-  time_str.tm_sec = atoi(ss);
-  time_str.tm_isdst = 0;
+    if (ltimes[ii]!=-1) iok++;
+  }
 
-  return mktime(&time_str);
+  return iok;
 }
 
 // 把字符串表示的时间加上一个偏移的秒数后得到一个新的字符串表示的时间。
@@ -1436,235 +2885,988 @@ bool FileMTime(const char *filename,char *mtime,const char *fmt)
   if (fmt==0) strcpy(strfmt,"yyyymmddhh24miss");
   else strcpy(strfmt,fmt);
 
-  timetostr(st_filestat.st_mtime,mtime,strfmt);
+  timetostr(st_filestat.st_mtime,mtime,strfmt);
+
+  return true;
+}
+
+
+CDir::CDir()
+{
+  m_pos=0;
+
+  STRCPY(m_DateFMT,sizeof(m_DateFMT),"yyyy-mm-dd hh24:mi:ss");
+
+  m_vFileName.clear();
+
+  initdata();
+}
+
+void CDir::initdata()
+{
+  memset(m_DirName,0,sizeof(m_DirName));
+  memset(m_FileName,0,sizeof(m_FileName));
+  memset(m_FullFileName,0,sizeof(m_FullFileName));
+  m_FileSize=0;
+  memset(m_CreateTime,0,sizeof(m_CreateTime));
+  memset(m_ModifyTime,0,sizeof(m_ModifyTime));
+  memset(m_AccessTime,0,sizeof(m_AccessTime));
+}
+
+// 设置文件时间的格式，支持"yyyy-mm-dd hh24:mi:ss"和"yyyymmddhh24miss"两种，缺省是前者。
+void CDir::SetDateFMT(const char *in_DateFMT)
+{
+  memset(m_DateFMT,0,sizeof(m_DateFMT));
+  STRCPY(m_DateFMT,sizeof(m_DateFMT),in_DateFMT);
+}
+
+// 打开目录，获取目录中的文件列表信息，存放于m_vFileName容器中。
+// in_DirName，待打开的目录名。
+// in_MatchStr，待获取文件名的匹配规则，不匹配的文件被忽略。
+// in_MaxCount，获取文件的最大数量，缺省值为10000个。
+// bAndChild，是否打开各级子目录，缺省值为false-不打开子目录。
+// bSort，是否对获取到的文件列表（即m_vFileName容器中的内容）进行排序，缺省值为false-不排序。
+// threads，扫描子目录的线程数，缺省值为1，bAndChild为true且threads大于1时用CDirWalker扫描。
+// 返回值：如果in_DirName参数指定的目录不存在，OpenDir方法会创建该目录，如果创建失败，返回false，当前用户没有读取权限的子目录被跳过，不会返回false，其它正常情况下都会返回true。
+bool CDir::OpenDir(const char *in_DirName,const char *in_MatchStr,const unsigned int in_MaxCount,const bool bAndChild,bool bSort,const int threads)
+{
+  // 匹配规则只编译一次，不必为目录中的每个文件拆分规则
+  CMatchRule MatchRule(in_MatchStr);
+
+  return OpenDir(in_DirName,MatchRule,in_MaxCount,bAndChild,bSort,threads);
+}
+
+bool CDir::OpenDir(const char *in_DirName,const CMatchRule &in_MatchRule,const unsigned int in_MaxCount,const bool bAndChild,bool bSort,const int threads)
+{
+  m_pos=0;
+  m_vFileName.clear();
+
+  // 多线程扫描各级子目录，排序也由CDirWalker完成。
+  if ( (bAndChild==true) && (threads>1) )
+  {
+    CDirWalker DirWalker;
+
+    if (DirWalker.OpenDir(in_DirName,in_MatchRule,threads,bSort,in_MaxCount)==false) return false;
+
+    m_vFileName.reserve(DirWalker.Count());
+    while (DirWalker.ReadDir()==true) m_vFileName.push_back(DirWalker.m_FullFileName);
+
+    return true;
+  }
+
+  // 如果目录不存在，就创建该目录
+  if (MKDIR(in_DirName,false) == false) return false;
+
+  bool bRet=_OpenDir(in_DirName,in_MatchRule,in_MaxCount,bAndChild);
+
+  if (bSort==true)
+  {
+    sort(m_vFileName.begin(), m_vFileName.end());
+  }
+
+  return bRet;
+}
+
+// 被OpenDir()调用，用CDirScanner扫描目录，把能匹配上的文件放入m_vFileName容器中，在CDir类的外部不需要调用它。
+// 无法打开的子目录被跳过，不影响其它文件。
+bool CDir::_OpenDir(const char *in_DirName,const CMatchRule &in_MatchRule,const unsigned int in_MaxCount,const bool bAndChild)
+{
+  CDirScanner DirScanner;
+
+  if (DirScanner.OpenDir(in_DirName,in_MatchRule,bAndChild)==false) return false;
+
+  while ( (m_vFileName.size()<in_MaxCount) && (DirScanner.ReadDir()==true) )
+  {
+    m_vFileName.push_back(DirScanner.m_FullFileName);
+  }
+
+  return true;
+}
+
+/*
+st_gid 
+  Numeric identifier of group that owns file (UNIX-specific) This field will always be zero on NT systems. A redirected file is classified as an NT file.
+st_atime
+  Time of last access of file.
+st_ctime
+  Time of creation of file.
+st_dev
+  Drive number of the disk containing the file (same as st_rdev).
+st_ino
+  Number of the information node (the inode) for the file (UNIX-specific). On UNIX file systems, the inode describes the file date and time stamps, permissions, and content. When files are hard-linked to one another, they share the same inode. The inode, and therefore st_ino, has no meaning in the FAT, HPFS, or NTFS file systems.
+st_mode
+  Bit mask for file-mode information. The _S_IFDIR bit is set if path specifies a directory; the _S_IFREG bit is set if path specifies an ordinary file or a device. User read/write bits are set according to the file’s permission mode; user execute bits are set according to the filename extension.
+st_mtime
+  Time of last modification of file.
+st_nlink
+  Always 1 on non-NTFS file systems.
+st_rdev
+  Drive number of the disk containing the file (same as st_dev).
+st_size
+  Size of the file in bytes; a 64-bit integer for _stati64 and _wstati64
+st_uid
+  Numeric identifier of user who owns file (UNIX-specific). This field will always be zero on NT systems. A redirected file is classified as an NT file.
+*/
+
+// 从m_vFileName容器中获取一条记录（文件名），同时得到该文件的大小、修改时间等信息。
+// 调用OpenDir方法时，m_vFileName容器被清空，m_pos归零，每调用一次ReadDir方法m_pos加1。
+// 当m_pos小于m_vFileName.size()，返回true，否则返回false。
+bool CDir::ReadDir()
+{
+  PROFILE("CDir::ReadDir");
+
+  initdata();
+
+  int ivsize=m_vFileName.size();
+
+  // 如果已读完，清空容器
+  if (m_pos >= ivsize) 
+  {
+    m_pos=0; m_vFileName.clear(); return false;
+  }
+
+  const string &filename=m_vFileName[m_pos];
+
+  size_t pos=filename.find_last_of('/');
+
+  // 目录名
+  STRNCPY(m_DirName,sizeof(m_DirName),filename.c_str(),pos);
+
+  // 文件名
+  STRCPY(m_FileName,sizeof(m_FileName),filename.c_str()+pos+1);
+
+  // 文件全名，包括路径
+  STRCPY(m_FullFileName,sizeof(m_FullFileName),filename.c_str());
+
+  struct stat st_filestat;
+
+  stat(m_FullFileName,&st_filestat);
+
+  m_FileSize=st_filestat.st_size;
+
+  // 同一个目录中的文件时间大多在同一个小时内，timetostr有缓存，不必每次调用localtime。
+  timetostr(st_filestat.st_mtime,m_ModifyTime,m_DateFMT);
+  timetostr(st_filestat.st_ctime,m_CreateTime,m_DateFMT);
+  timetostr(st_filestat.st_atime,m_AccessTime,m_DateFMT);
+
+  m_pos++;
+
+  return true;
+}
+
+CDir::~CDir()
+{
+  m_vFileName.clear();
+
+  // m_vDirName.clear();
+}
+
+// getdents64系统调用返回的目录项，glibc没有提供这个结构体的定义。
+struct st_dirent64
+{
+  ino64_t        d_ino;       // inode号。
+  off64_t        d_off;       // 下一个目录项的位置。
+  unsigned short d_reclen;    // 目录项的长度。
+  unsigned char  d_type;      // 文件的类型，DT_DIR、DT_REG、DT_LNK等，有的文件系统不提供，为DT_UNKNOWN。
+  char           d_name[];    // 文件名，以0结尾。
+};
+
+#define DIRBUFSIZE 32768    // 每次getdents64读取目录项的缓冲区大小。
+
+CDirScanner::CDirScanner()
+{
+  m_bAndChild=false;
+  m_count=m_errcount=0;
+  m_psubdirs=0;
+
+  memset(m_DirName,0,sizeof(m_DirName));
+  memset(m_FileName,0,sizeof(m_FileName));
+  memset(m_FullFileName,0,sizeof(m_FullFileName));
+  m_FileSize=0;
+  m_mtime=m_ctime=m_atime=0;
+  m_inode=0;
+  memset(m_ModifyTime,0,sizeof(m_ModifyTime));
+  memset(m_DateFMT,0,sizeof(m_DateFMT));
+}
+
+CDirScanner::~CDirScanner()
+{
+  CloseDir();
+}
+
+// 设置m_ModifyTime的格式。
+void CDirScanner::SetDateFMT(const char *in_DateFMT)
+{
+  STRCPY(m_DateFMT,sizeof(m_DateFMT),in_DateFMT);
+}
+
+// 设置存放子目录名的容器。
+void CDirScanner::SetSubDirs(vector<string> *psubdirs)
+{
+  m_psubdirs=psubdirs;
+}
+
+bool CDirScanner::OpenDir(const char *in_DirName,const char *in_MatchStr,const bool bAndChild,const bool bCreate)
+{
+  CMatchRule MatchRule(in_MatchStr);
+
+  return OpenDir(in_DirName,MatchRule,bAndChild,bCreate);
+}
+
+bool CDirScanner::OpenDir(const char *in_DirName,const CMatchRule &in_MatchRule,const bool bAndChild,const bool bCreate)
+{
+  CloseDir();
+
+  m_MatchRule=in_MatchRule;
+  m_bAndChild=bAndChild;
+  m_count=m_errcount=0;
+
+  // 目录名以'/'结尾，去掉重复的'/'，与CDir中的文件名相同。
+  m_path=in_DirName;
+  m_path.append(1,'/');
+  size_t pos;
+  while ( (pos=m_path.find("//")) != string::npos ) m_path.erase(pos,1);
+
+  if (PushDir(AT_FDCWD,in_DirName)==true) return true;
+
+  // 如果目录不存在，就创建该目录，目录一般是存在的，先打开，不必每次都逐级检查。
+  if ( (bCreate==false) || (errno!=ENOENT) || (MKDIR(in_DirName,false) == false) ) return false;
+
+  return PushDir(AT_FDCWD,in_DirName);
+}
+
+// 打开一级目录，放入m_frames中。
+bool CDirScanner::PushDir(const int dirfd,const char *name)
+{
+  int fd=openat(dirfd,name,O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+
+  if (fd<0) return false;
+
+  m_frames.emplace_back();
+
+  struct st_dirframe &frame=m_frames.back();
+  frame.fd=fd;
+  frame.pathlen=m_path.size();
+  frame.buffer.resize(DIRBUFSIZE);
+  frame.bpos=frame.blen=0;
+
+  return true;
+}
+
+// 关闭当前目录，返回到上级目录。
+void CDirScanner::PopDir()
+{
+  close(m_frames.back().fd);
+
+  m_frames.pop_back();
+
+  if (m_frames.empty()==false) m_path.resize(m_frames.back().pathlen);
+}
+
+// 关闭全部已打开的目录。
+void CDirScanner::CloseDir()
+{
+  while (m_frames.empty()==false) PopDir();
+
+  m_path.clear();
+}
+
+// 获取下一个文件。
+bool CDirScanner::ReadDir()
+{
+  while (m_frames.empty()==false)
+  {
+    struct st_dirframe &frame=m_frames.back();
+
+    // 缓冲区中的目录项已处理完，读取下一批，读完了就返回上级目录。
+    if (frame.bpos>=frame.blen)
+    {
+      long ilen=syscall(SYS_getdents64,frame.fd,frame.buffer.data(),frame.buffer.size());
+
+      if (ilen<=0)
+      {
+        if (ilen<0) m_errcount++;
+        PopDir(); continue;
+      }
+
+      frame.blen=ilen; frame.bpos=0;
+    }
+
+    struct st_dirent64 *dirent=(struct st_dirent64 *)(frame.buffer.data()+frame.bpos);
+    frame.bpos=frame.bpos+dirent->d_reclen;
+
+    const char *name=dirent->d_name;
+
+    // 以"."打头的文件不处理
+    if (name[0]=='.') continue;
+
+    // 文件系统不提供文件类型或是符号链接时，才需要先获取文件信息，符号链接与stat相同，取它指向的文件。
+    struct stat st_filestat;
+    bool bstat=false;
+    bool bdir=(dirent->d_type==DT_DIR);
+
+    if ( (dirent->d_type==DT_UNKNOWN) || (dirent->d_type==DT_LNK) )
+    {
+      if (fstatat(frame.fd,name,&st_filestat,0)!=0) { m_errcount++; continue; }
+
+      bstat=true; bdir=S_ISDIR(st_filestat.st_mode);
+    }
+
+    size_t namelen=strlen(name);
+
+    // 目录名超过300字节时，其中的文件名都会超过300字节，不再打开，也避免了符号链接成环时无限地打开下去。
+    if (bdir==true)
+    {
+      if (m_bAndChild==false) continue;
+
+      if (m_path.size()+namelen+1>300) { m_errcount++; continue; }
+
+      // 由调用者扫描子目录。
+      if (m_psubdirs!=0) { m_psubdirs->push_back(m_path+name); continue; }
+
+      int dirfd=frame.fd;        // PushDir之后frame不再有效。
+      m_path.append(name,namelen).append(1,'/');
+      if (PushDir(dirfd,name)==false) { m_path.resize(m_path.size()-namelen-1); m_errcount++; }
+
+      continue;
+    }
+
+    // 文件名不匹配的文件不获取文件信息。
+    if (m_MatchRule.Match(name)==false) continue;
+
+    if (m_path.size()+namelen>300) { m_errcount++; continue; }
+
+    // 文件可能在读取目录项之后被删除了。
+    if ( (bstat==false) && (fstatat(frame.fd,name,&st_filestat,0)!=0) ) { m_errcount++; continue; }
+
+    STRNCPY(m_DirName,sizeof(m_DirName),m_path.c_str(),m_path.size()-1);
+    STRCPY(m_FileName,sizeof(m_FileName),name);
+    memcpy(m_FullFileName,m_path.c_str(),m_path.size());
+    memcpy(m_FullFileName+m_path.size(),name,namelen+1);
+
+    m_FileSize=st_filestat.st_size;
+    m_mtime=st_filestat.st_mtime;
+    m_ctime=st_filestat.st_ctime;
+    m_atime=st_filestat.st_atime;
+    m_inode=st_filestat.st_ino;
+
+    if (m_DateFMT[0]!=0) timetostr(m_mtime,m_ModifyTime,m_DateFMT);
+
+    m_count++;
+
+    return true;
+  }
+
+  return false;
+}
+
+// 重新获取当前文件的信息。
+bool CDirScanner::Refresh()
+{
+  struct stat st_filestat;
+
+  if (stat(m_FullFileName,&st_filestat)!=0) return false;
+
+  m_FileSize=st_filestat.st_size;
+  m_mtime=st_filestat.st_mtime;
+  m_ctime=st_filestat.st_ctime;
+  m_atime=st_filestat.st_atime;
+  m_inode=st_filestat.st_ino;
+
+  if (m_DateFMT[0]!=0) timetostr(m_mtime,m_ModifyTime,m_DateFMT);
+
+  return true;
+}
+
+CDirWalker::CDirWalker()
+{
+  m_pos=0;
+  m_pending=0; m_count=0; m_errcount=0;
+  m_maxcount=0;
+  m_bSort=false;
+
+  memset(m_DirName,0,sizeof(m_DirName));
+  memset(m_FileName,0,sizeof(m_FileName));
+  memset(m_FullFileName,0,sizeof(m_FullFileName));
+  m_FileSize=0;
+  m_mtime=0;
+  memset(m_ModifyTime,0,sizeof(m_ModifyTime));
+  memset(m_DateFMT,0,sizeof(m_DateFMT));
+}
+
+// 设置m_ModifyTime的格式。
+void CDirWalker::SetDateFMT(const char *in_DateFMT)
+{
+  STRCPY(m_DateFMT,sizeof(m_DateFMT),in_DateFMT);
+}
+
+bool CDirWalker::OpenDir(const char *in_DirName,const char *in_MatchStr,const int threads,const bool bSort,const unsigned int in_MaxCount)
+{
+  CMatchRule MatchRule(in_MatchStr);
+
+  return OpenDir(in_DirName,MatchRule,threads,bSort,in_MaxCount);
+}
+
+bool CDirWalker::OpenDir(const char *in_DirName,const CMatchRule &in_MatchRule,const int threads,const bool bSort,const unsigned int in_MaxCount)
+{
+  m_vFiles.clear(); m_pos=0;
+  m_pending=0; m_count=0; m_errcount=0;
+  m_MatchRule=in_MatchRule;
+  m_maxcount=in_MaxCount;
+  m_bSort=bSort;
+
+  // 先检查根目录能否打开，不能打开的话与CDirScanner::OpenDir相同，返回失败。
+  CDirScanner DirScanner;
+  if (DirScanner.OpenDir(in_DirName,"",false)==false) return false;
+  DirScanner.CloseDir();
+
+  int ithreads=(threads<1)?1:threads;
+
+  m_queues.clear(); m_queues.resize(ithreads);
+  m_parts.clear();  m_parts.resize(ithreads);
+  for (int ii=0;ii<ithreads;ii++) pthread_mutex_init(&m_queues[ii].mutex,0);
+
+  // 根目录放入第0个线程的队列，其它线程一开始就从它的队列中取子目录。
+  m_queues[0].dirs.push_back(in_DirName);
+  m_pending=1;
+
+  vector<struct st_walkarg> args(ithreads);
+  vector<pthread_t> vthid(ithreads);
+
+  int icreated=0;
+  for (int ii=0;ii<ithreads;ii++)
+  {
+    args[ii].walker=this; args[ii].id=ii;
+    if (pthread_create(&vthid[ii],0,WalkThread,&args[ii])!=0) break;
+    icreated++;
+  }
+
+  // 一个线程也没有创建成功时，在本线程中扫描。
+  if (icreated==0) Walk(0);
+
+  for (int ii=0;ii<icreated;ii++) pthread_join(vthid[ii],0);
+
+  for (int ii=0;ii<ithreads;ii++) pthread_mutex_destroy(&m_queues[ii].mutex);
+
+  MergeParts();
+
+  return true;
+}
+
+void *CDirWalker::WalkThread(void *arg)
+{
+  struct st_walkarg *walkarg=(struct st_walkarg *)arg;
+
+  walkarg->walker->Walk(walkarg->id);
+
+  return 0;
+}
+
+// 取出一个待扫描的目录。
+bool CDirWalker::PopDir(const int id,string &dirname)
+{
+  int ithreads=m_queues.size();
+
+  for (int ii=0;ii<ithreads;ii++)
+  {
+    struct st_walkqueue &queue=m_queues[(id+ii)%ithreads];
+
+    pthread_mutex_lock(&queue.mutex);
+
+    if (queue.dirs.empty()==false)
+    {
+      // 自己的队列从尾部取，接着扫描刚发现的子目录；其它线程的队列从头部取，取走的是离根目录较近的目录，子目录较多。
+      if (ii==0) { dirname=move(queue.dirs.back());  queue.dirs.pop_back(); }
+      else       { dirname=move(queue.dirs.front()); queue.dirs.pop_front(); }
+
+      pthread_mutex_unlock(&queue.mutex);
+      return true;
+    }
+
+    pthread_mutex_unlock(&queue.mutex);
+  }
+
+  return false;
+}
+
+// 反复取出一个目录并扫描，直到全部的目录都扫描完。
+void CDirWalker::Walk(const int id)
+{
+  CDirScanner DirScanner;
+  vector<string> vsubdirs;
+  vector<struct st_walkfile> &vfiles=m_parts[id];
+  string dirname;
+
+  DirScanner.SetSubDirs(&vsubdirs);
+
+  while (m_pending>0)
+  {
+    // 已达到文件数的上限，不再扫描，其它线程也会在扫描完当前目录后退出。
+    if ( (m_maxcount>0) && (m_count>=(long)m_maxcount) ) break;
+
+    // 暂时没有可以取的目录，其它线程可能正在扫描目录，还会放入新的子目录。
+    if (PopDir(id,dirname)==false) { usleep(100); continue; }
+
+    vsubdirs.clear();
+
+    // 目录可能在放入队列之后被删除了，不能再创建出来，根目录在OpenDir方法中已创建。
+    if (DirScanner.OpenDir(dirname.c_str(),m_MatchRule,true,false)==false)
+    {
+      m_errcount++;
+    }
+    else
+    {
+      while (DirScanner.ReadDir()==true)
+      {
+        if ( (m_maxcount>0) && (m_count.fetch_add(1)>=(long)m_maxcount) ) break;
+
+        vfiles.push_back({DirScanner.m_FullFileName,DirScanner.m_FileSize,DirScanner.m_mtime});
+      }
+
+      m_errcount+=DirScanner.ErrCount();
+    }
+
+    // 子目录先计入m_pending，再减去本目录，m_pending不会在还有目录没扫描时变为0。
+    if (vsubdirs.empty()==false)
+    {
+      m_pending+=vsubdirs.size();
+
+      pthread_mutex_lock(&m_queues[id].mutex);
+      for (auto &subdir:vsubdirs) m_queues[id].dirs.push_back(move(subdir));
+      pthread_mutex_unlock(&m_queues[id].mutex);
+    }
+
+    m_pending--;
+  }
+
+  // 各线程先对自己的结果排序，合并时只需要归并。
+  if (m_bSort==true)
+  {
+    sort(vfiles.begin(),vfiles.end(),[](const struct st_walkfile &a,const struct st_walkfile &b) { return a.filename<b.filename; });
+  }
+}
+
+void *CDirWalker::MergeThread(void *arg)
+{
+  struct st_walkmerge *merge=(struct st_walkmerge *)arg;
+
+  vector<struct st_walkfile> &first=*merge->first;
+  vector<struct st_walkfile> &second=*merge->second;
+  vector<struct st_walkfile> &result=*merge->result;
+
+  result.reserve(first.size()+second.size());
+  std::merge(make_move_iterator(first.begin()),make_move_iterator(first.end()),
+             make_move_iterator(second.begin()),make_move_iterator(second.end()),
+             back_inserter(result),
+             [](const struct st_walkfile &a,const struct st_walkfile &b) { return a.filename<b.filename; });
+
+  vector<struct st_walkfile>().swap(first);
+  vector<struct st_walkfile>().swap(second);
+
+  return 0;
+}
+
+// 合并各线程的扫描结果。
+void CDirWalker::MergeParts()
+{
+  // 不排序时直接拼接。
+  if (m_bSort==false)
+  {
+    size_t total=0;
+    for (auto &part:m_parts) total=total+part.size();
+
+    m_vFiles.reserve(total);
+    for (auto &part:m_parts)
+    {
+      move(part.begin(),part.end(),back_inserter(m_vFiles));
+    }
+    m_parts.clear();
+    return;
+  }
+
+  // 每一轮把相邻的两个结果归并为一个，每一对用一个线程，结果的个数减半，直到只剩一个。
+  while (m_parts.size()>1)
+  {
+    int ipairs=m_parts.size()/2;
+
+    vector<vector<struct st_walkfile>> vmerged(ipairs+m_parts.size()%2);
+    vector<struct st_walkmerge> vmerge(ipairs);
+    vector<pthread_t> vthid(ipairs);
+    vector<bool> vcreated(ipairs,false);
+
+    for (int ii=0;ii<ipairs;ii++)
+    {
+      vmerge[ii].first=&m_parts[ii*2]; vmerge[ii].second=&m_parts[ii*2+1]; vmerge[ii].result=&vmerged[ii];
+
+      // 创建线程失败时在本线程中归并。
+      if (pthread_create(&vthid[ii],0,MergeThread,&vmerge[ii])==0) vcreated[ii]=true;
+      else MergeThread(&vmerge[ii]);
+    }
+
+    for (int ii=0;ii<ipairs;ii++)
+    {
+      if (vcreated[ii]==true) pthread_join(vthid[ii],0);
+    }
+
+    if (m_parts.size()%2==1) vmerged.back()=move(m_parts.back());
+
+    m_parts.swap(vmerged);
+  }
+
+  if (m_parts.empty()==false) m_vFiles=move(m_parts[0]);
+
+  m_parts.clear();
+}
+
+// 获取下一个文件的信息。
+bool CDirWalker::ReadDir()
+{
+  if (m_pos>=m_vFiles.size()) return false;
+
+  const struct st_walkfile &file=m_vFiles[m_pos++];
+
+  size_t pos=file.filename.find_last_of('/');
+
+  STRNCPY(m_DirName,sizeof(m_DirName),file.filename.c_str(),pos);
+  STRCPY(m_FileName,sizeof(m_FileName),file.filename.c_str()+pos+1);
+  STRCPY(m_FullFileName,sizeof(m_FullFileName),file.filename.c_str());
+  m_FileSize=file.filesize;
+  m_mtime=file.mtime;
+
+  if (m_DateFMT[0]!=0) timetostr(m_mtime,m_ModifyTime,m_DateFMT);
 
   return true;
 }
 
-
-CDir::CDir()
+// 重新获取当前文件的信息，扫描完到处理文件之间可能已经过了很长时间。
+bool CDirWalker::Refresh()
 {
-  m_pos=0;
+  struct stat st_filestat;
 
-  STRCPY(m_DateFMT,sizeof(m_DateFMT),"yyyy-mm-dd hh24:mi:ss");
+  if (stat(m_FullFileName,&st_filestat)!=0) return false;
 
-  m_vFileName.clear();
+  m_FileSize=st_filestat.st_size;
+  m_mtime=st_filestat.st_mtime;
 
-  initdata();
+  if (m_DateFMT[0]!=0) timetostr(m_mtime,m_ModifyTime,m_DateFMT);
+
+  return true;
 }
 
-void CDir::initdata()
+// 快照文件的标志，格式变化时修改它，旧的快照文件作废。
+#define SNAPMAGIC "DIRSNAP1"
+
+CDirSnapshot::CDirSnapshot()
 {
+  m_dirpos=m_filepos=0;
+  m_count=m_cachedcount=m_scancount=m_errcount=0;
+
   memset(m_DirName,0,sizeof(m_DirName));
   memset(m_FileName,0,sizeof(m_FileName));
   memset(m_FullFileName,0,sizeof(m_FullFileName));
   m_FileSize=0;
-  memset(m_CreateTime,0,sizeof(m_CreateTime));
-  memset(m_ModifyTime,0,sizeof(m_ModifyTime));
-  memset(m_AccessTime,0,sizeof(m_AccessTime));
+  m_mtime=0;
+  m_inode=0;
+  m_bCached=false;
 }
 
-// 设置文件时间的格式，支持"yyyy-mm-dd hh24:mi:ss"和"yyyymmddhh24miss"两种，缺省是前者。
-void CDir::SetDateFMT(const char *in_DateFMT)
+// 快照文件的解析器，每个字段定长或以长度打头，越界时置m_bOK为false，不再读取。
+struct st_snapreader
 {
-  memset(m_DateFMT,0,sizeof(m_DateFMT));
-  STRCPY(m_DateFMT,sizeof(m_DateFMT),in_DateFMT);
-}
+  const char *m_pos;
+  const char *m_end;
+  bool m_bOK;
 
-// 打开目录，获取目录中的文件列表信息，存放于m_vFileName容器中。
-// in_DirName，待打开的目录名。
-// in_MatchStr，待获取文件名的匹配规则，不匹配的文件被忽略。
-// in_MaxCount，获取文件的最大数量，缺省值为10000个。
-// bAndChild，是否打开各级子目录，缺省值为false-不打开子目录。
-// bSort，是否对获取到的文件列表（即m_vFileName容器中的内容）进行排序，缺省值为false-不排序。
-// 返回值：如果in_DirName参数指定的目录不存在，OpenDir方法会创建该目录，如果创建失败，返回false，还有，如果当前用户对in_DirName目录下的子目录没有读取权限也会返回false，其它正常情况下都会返回true。
-bool CDir::OpenDir(const char *in_DirName,const char *in_MatchStr,const unsigned int in_MaxCount,const bool bAndChild,bool bSort)
-{
-  m_pos=0;
-  m_vFileName.clear();
+  st_snapreader(const string &buffer) { m_pos=buffer.data(); m_end=m_pos+buffer.size(); m_bOK=true; }
 
-  // 如果目录不存在，就创建该目录
-  if (MKDIR(in_DirName,false) == false) return false;
+  int64_t Int64()
+  {
+    int64_t value=0;
+    if ( (m_bOK==false) || (m_end-m_pos<8) ) { m_bOK=false; return 0; }
+    memcpy(&value,m_pos,8); m_pos=m_pos+8;
+    return value;
+  }
 
-  bool bRet=_OpenDir(in_DirName,in_MatchStr,in_MaxCount,bAndChild);
+  uint32_t Uint32()
+  {
+    uint32_t value=0;
+    if ( (m_bOK==false) || (m_end-m_pos<4) ) { m_bOK=false; return 0; }
+    memcpy(&value,m_pos,4); m_pos=m_pos+4;
+    return value;
+  }
 
-  if (bSort==true)
+  void String(string &str)
   {
-    sort(m_vFileName.begin(), m_vFileName.end());
+    uint32_t len=Uint32();
+    if ( (m_bOK==false) || ((size_t)(m_end-m_pos)<len) ) { m_bOK=false; return; }
+    str.assign(m_pos,len); m_pos=m_pos+len;
   }
+};
 
-  return bRet;
-}
+// 快照文件的写入，字段的格式与st_snapreader对应。
+static void SnapInt64(CFile &File,const int64_t value) { File.Append((const char *)&value,8); }
+static void SnapUint32(CFile &File,const uint32_t value) { File.Append((const char *)&value,4); }
+static void SnapString(CFile &File,const string &str) { SnapUint32(File,str.size()); File.Append(str.data(),str.size()); }
 
-// 这是一个递归函数，用于OpenDir()的调用，在CDir类的外部不需要调用它。
-bool CDir::_OpenDir(const char *in_DirName,const char *in_MatchStr,const unsigned int in_MaxCount,const bool bAndChild)
+// 从快照文件中加载上次扫描的结果。
+// 快照文件的格式：SNAPMAGIC、目录名、匹配规则、目录数，然后是每个目录：目录名、修改时间的秒数和纳秒数、文件数、
+// 子目录数、每个文件（文件名、大小、修改时间、inode号）、每个子目录名，整数采用本机字节序，字符串以长度打头。
+bool CDirSnapshot::LoadSnapshot(unordered_map<string,struct st_snapdir> &mdirs)
 {
-  DIR *dir;
+  string buffer;
+  time_t mtime;
 
-  if ( (dir=opendir(in_DirName)) == 0 ) return false;
+  if (ReadWholeFile(m_snapfile.c_str(),buffer,mtime)==false) return false;
 
-  char strTempFileName[3001];
+  if ( (buffer.size()<strlen(SNAPMAGIC)) || (memcmp(buffer.data(),SNAPMAGIC,strlen(SNAPMAGIC))!=0) ) return false;
 
-  struct dirent *st_fileinfo;
-  struct stat st_filestat;
+  struct st_snapreader reader(buffer);
+  reader.m_pos=reader.m_pos+strlen(SNAPMAGIC);
+
+  string root,matchstr;
+  reader.String(root);
+  reader.String(matchstr);
+
+  // 目录名或匹配规则变化后，快照中的内容不能再用。
+  if ( (reader.m_bOK==false) || (root!=m_root) || (matchstr!=m_matchstr) ) return false;
+
+  uint32_t dircount=reader.Uint32();
 
-  while ((st_fileinfo=readdir(dir)) != 0)
+  for (uint32_t ii=0;(ii<dircount)&&(reader.m_bOK==true);ii++)
   {
-    // 以"."打头的文件不处理
-    if (st_fileinfo->d_name[0]=='.') continue;
-        
-    SNPRINTF(strTempFileName,sizeof(strTempFileName),300,"%s//%s",in_DirName,st_fileinfo->d_name);
+    struct st_snapdir snapdir;
+
+    reader.String(snapdir.path);
+    snapdir.mtimesec=reader.Int64();
+    snapdir.mtimensec=reader.Int64();
+    uint32_t nfiles=reader.Uint32();
+    uint32_t nsubdirs=reader.Uint32();
 
-    UpdateStr(strTempFileName,"//","/");
+    // 每个文件至少28字节，每个子目录至少4字节，文件损坏时不会按错误的数量分配内存。
+    if ( (reader.m_bOK==false) || ((size_t)(reader.m_end-reader.m_pos)<(size_t)nfiles*28+(size_t)nsubdirs*4) ) return false;
 
-    stat(strTempFileName,&st_filestat);
+    snapdir.vfiles.resize(nfiles);
 
-    // 判断是否是目录，如果是，处理各级子目录。
-    if (S_ISDIR(st_filestat.st_mode))
+    for (uint32_t jj=0;jj<nfiles;jj++)
     {
-      if (bAndChild == true)
-      {
-        if (_OpenDir(strTempFileName,in_MatchStr,in_MaxCount,bAndChild) == false) 
-        {
-          closedir(dir); return false;
-        }
-      }
+      struct st_snapfile &file=snapdir.vfiles[jj];
+      reader.String(file.name);
+      file.filesize=reader.Int64();
+      file.mtime=reader.Int64();
+      file.inode=reader.Int64();
     }
-    else
-    {
-      // 如果是文件，把能匹配上的文件放入m_vFileName容器中。
-      if (MatchStr(st_fileinfo->d_name,in_MatchStr) == false) continue;
 
-      m_vFileName.push_back(strTempFileName);
+    snapdir.vsubdirs.resize(nsubdirs);
 
-      if ( m_vFileName.size()>=in_MaxCount ) break;
-    }
+    for (uint32_t jj=0;jj<nsubdirs;jj++) reader.String(snapdir.vsubdirs[jj]);
+
+    snapdir.bcached=false;
+
+    if (reader.m_bOK==true) mdirs[snapdir.path]=move(snapdir);
   }
 
-  closedir(dir);
+  // 快照文件不完整，全部重新扫描。
+  if (reader.m_bOK==false) { mdirs.clear(); return false; }
 
   return true;
 }
 
-/*
-st_gid 
-  Numeric identifier of group that owns file (UNIX-specific) This field will always be zero on NT systems. A redirected file is classified as an NT file.
-st_atime
-  Time of last access of file.
-st_ctime
-  Time of creation of file.
-st_dev
-  Drive number of the disk containing the file (same as st_rdev).
-st_ino
-  Number of the information node (the inode) for the file (UNIX-specific). On UNIX file systems, the inode describes the file date and time stamps, permissions, and content. When files are hard-linked to one another, they share the same inode. The inode, and therefore st_ino, has no meaning in the FAT, HPFS, or NTFS file systems.
-st_mode
-  Bit mask for file-mode information. The _S_IFDIR bit is set if path specifies a directory; the _S_IFREG bit is set if path specifies an ordinary file or a device. User read/write bits are set according to the file’s permission mode; user execute bits are set according to the filename extension.
-st_mtime
-  Time of last modification of file.
-st_nlink
-  Always 1 on non-NTFS file systems.
-st_rdev
-  Drive number of the disk containing the file (same as st_dev).
-st_size
-  Size of the file in bytes; a 64-bit integer for _stati64 and _wstati64
-st_uid
-  Numeric identifier of user who owns file (UNIX-specific). This field will always be zero on NT systems. A redirected file is classified as an NT file.
-*/
-
-// 从m_vFileName容器中获取一条记录（文件名），同时得到该文件的大小、修改时间等信息。
-// 调用OpenDir方法时，m_vFileName容器被清空，m_pos归零，每调用一次ReadDir方法m_pos加1。
-// 当m_pos小于m_vFileName.size()，返回true，否则返回false。
-bool CDir::ReadDir()
+// 扫描一个目录，获取其中能匹配上的文件和全部的子目录。
+bool CDirSnapshot::ScanDir(const CMatchRule &MatchRule,struct st_snapdir &snapdir,const bool bCreate)
 {
-  initdata();
+  snapdir.vfiles.clear();
+  snapdir.vsubdirs.clear();
 
-  int ivsize=m_vFileName.size();
+  CDirScanner Dir;
+  Dir.SetSubDirs(&snapdir.vsubdirs);    // 子目录由OpenDir方法逐个检查修改时间，不由CDirScanner打开。
 
-  // 如果已读完，清空容器
-  if (m_pos >= ivsize) 
+  if (Dir.OpenDir(snapdir.path.c_str(),MatchRule,true,bCreate)==false) return false;
+
+  while (Dir.ReadDir()==true)
   {
-    m_pos=0; m_vFileName.clear(); return false;
+    snapdir.vfiles.emplace_back();
+
+    struct st_snapfile &file=snapdir.vfiles.back();
+    file.name=Dir.m_FileName;
+    file.filesize=Dir.m_FileSize;
+    file.mtime=Dir.m_mtime;
+    file.inode=Dir.m_inode;
   }
 
-  int pos=0;
+  m_errcount=m_errcount+Dir.ErrCount();
 
-  pos=m_vFileName[m_pos].find_last_of("/");
+  return true;
+}
 
-  // 目录名
-  STRCPY(m_DirName,sizeof(m_DirName),m_vFileName[m_pos].substr(0,pos).c_str());
+bool CDirSnapshot::OpenDir(const char *in_DirName,const char *in_MatchStr,const char *in_SnapFile)
+{
+  m_vdirs.clear();
+  m_dirpos=m_filepos=0;
+  m_count=m_cachedcount=m_scancount=m_errcount=0;
 
-  // 文件名
-  STRCPY(m_FileName,sizeof(m_FileName),m_vFileName[m_pos].substr(pos+1,m_vFileName[m_pos].size()-pos-1).c_str());
+  // 目录名不以'/'结尾，去掉重复的'/'，与CDirScanner中的目录名相同。
+  m_root=in_DirName;
+  size_t pos;
+  while ( (pos=m_root.find("//")) != string::npos ) m_root.erase(pos,1);
+  if ( (m_root.size()>1) && (m_root.back()=='/') ) m_root.pop_back();
 
-  // 文件全名，包括路径
-  SNPRINTF(m_FullFileName,sizeof(m_FullFileName),300,"%s",m_vFileName[m_pos].c_str());
+  m_matchstr=in_MatchStr;
+  m_snapfile=in_SnapFile;
 
-  struct stat st_filestat;
+  CMatchRule MatchRule(in_MatchStr);
 
-  stat(m_FullFileName,&st_filestat);
+  // 上次扫描的结果，快照文件无效时为空，全部重新扫描。
+  unordered_map<string,struct st_snapdir> mdirs;
+  LoadSnapshot(mdirs);
 
-  m_FileSize=st_filestat.st_size;
+  // 扫描开始前1秒之内修改过的目录，在扫描期间可能还有同一秒内的修改，这样的目录不记录修改时间。
+  time_t tstart=time(0)-1;
 
-  struct tm nowtimer;
+  vector<string> vstack;
+  vstack.push_back(m_root);
 
-  if (strcmp(m_DateFMT,"yyyy-mm-dd hh24:mi:ss") == 0)
+  while (vstack.empty()==false)
   {
-    nowtimer = *localtime(&st_filestat.st_mtime);
-    // localtime_r(&st_filestat.st_mtime,&nowtimer); 
-    nowtimer.tm_mon++;
-    snprintf(m_ModifyTime,20,"%04u-%02u-%02u %02u:%02u:%02u",\
-             nowtimer.tm_year+1900,nowtimer.tm_mon,nowtimer.tm_mday,\
-             nowtimer.tm_hour,nowtimer.tm_min,nowtimer.tm_sec);
+    struct st_snapdir snapdir;
+    snapdir.path=move(vstack.back());
+    vstack.pop_back();
+
+    struct stat st_dirstat;
+    bool broot=(m_vdirs.empty()==true);
+
+    // 子目录可能在上次扫描之后被删除了，根目录不存在时由CDirScanner创建。
+    if (stat(snapdir.path.c_str(),&st_dirstat)!=0)
+    {
+      if (broot==false) { m_errcount++; continue; }
+      st_dirstat.st_mtim.tv_sec=st_dirstat.st_mtim.tv_nsec=0;
+    }
+
+    snapdir.mtimesec=st_dirstat.st_mtim.tv_sec;
+    snapdir.mtimensec=st_dirstat.st_mtim.tv_nsec;
+    snapdir.bcached=false;
+
+    auto it=mdirs.find(snapdir.path);
+
+    // 目录的修改时间没有变化，说明目录中没有增加、删除或改名的文件，直接使用快照中的内容。
+    if ( (it!=mdirs.end()) && (it->second.mtimesec!=0) &&
+         (it->second.mtimesec==snapdir.mtimesec) && (it->second.mtimensec==snapdir.mtimensec) )
+    {
+      snapdir.vfiles=move(it->second.vfiles);
+      snapdir.vsubdirs=move(it->second.vsubdirs);
+      snapdir.bcached=true;
+      m_cachedcount++;
+    }
+    else
+    {
+      // 只有根目录不存在时才创建，子目录可能在stat之后被其它程序删除了，不能再创建出来。
+      if (ScanDir(MatchRule,snapdir,broot)==false)
+      {
+        if (broot==true) return false;
+        m_errcount++; continue;
+      }
+
+      // 根目录是刚创建的，重新获取它的修改时间。
+      if ( (broot==true) && (snapdir.mtimesec==0) && (stat(snapdir.path.c_str(),&st_dirstat)==0) )
+      {
+        snapdir.mtimesec=st_dirstat.st_mtim.tv_sec;
+        snapdir.mtimensec=st_dirstat.st_mtim.tv_nsec;
+      }
 
-    nowtimer = *localtime(&st_filestat.st_ctime);
-    // localtime_r(&st_filestat.st_ctime,&nowtimer); 
-    nowtimer.tm_mon++;
-    snprintf(m_CreateTime,20,"%04u-%02u-%02u %02u:%02u:%02u",\
-             nowtimer.tm_year+1900,nowtimer.tm_mon,nowtimer.tm_mday,\
-             nowtimer.tm_hour,nowtimer.tm_min,nowtimer.tm_sec);
+      m_scancount++;
+    }
+
+    if (snapdir.mtimesec>=tstart) snapdir.mtimesec=snapdir.mtimensec=0;
+
+    // 子目录逆序入栈，出栈的顺序与快照中的顺序相同。
+    for (auto rit=snapdir.vsubdirs.rbegin();rit!=snapdir.vsubdirs.rend();++rit) vstack.push_back(*rit);
+
+    m_count=m_count+snapdir.vfiles.size();
 
-    nowtimer = *localtime(&st_filestat.st_atime);
-    // localtime_r(&st_filestat.st_atime,&nowtimer); 
-    nowtimer.tm_mon++;
-    snprintf(m_AccessTime,20,"%04u-%02u-%02u %02u:%02u:%02u",\
-             nowtimer.tm_year+1900,nowtimer.tm_mon,nowtimer.tm_mday,\
-             nowtimer.tm_hour,nowtimer.tm_min,nowtimer.tm_sec);
+    m_vdirs.push_back(move(snapdir));
   }
 
-  if (strcmp(m_DateFMT,"yyyymmddhh24miss") == 0)
+  return true;
+}
+
+// 获取下一个文件的信息。
+bool CDirSnapshot::ReadDir()
+{
+  while (m_dirpos<m_vdirs.size())
   {
-    nowtimer = *localtime(&st_filestat.st_mtime);
-    // localtime_r(&st_filestat.st_mtime,&nowtimer); 
-    nowtimer.tm_mon++;
-    snprintf(m_ModifyTime,20,"%04u%02u%02u%02u%02u%02u",\
-             nowtimer.tm_year+1900,nowtimer.tm_mon,nowtimer.tm_mday,\
-             nowtimer.tm_hour,nowtimer.tm_min,nowtimer.tm_sec);
+    const struct st_snapdir &snapdir=m_vdirs[m_dirpos];
 
-    nowtimer = *localtime(&st_filestat.st_ctime);
-    // localtime_r(&st_filestat.st_ctime,&nowtimer); 
-    nowtimer.tm_mon++;
-    snprintf(m_CreateTime,20,"%04u%02u%02u%02u%02u%02u",\
-             nowtimer.tm_year+1900,nowtimer.tm_mon,nowtimer.tm_mday,\
-             nowtimer.tm_hour,nowtimer.tm_min,nowtimer.tm_sec);
+    if (m_filepos>=snapdir.vfiles.size()) { m_dirpos++; m_filepos=0; continue; }
 
-    nowtimer = *localtime(&st_filestat.st_atime);
-    // localtime_r(&st_filestat.st_atime,&nowtimer); 
-    nowtimer.tm_mon++;
-    snprintf(m_AccessTime,20,"%04u%02u%02u%02u%02u%02u",\
-             nowtimer.tm_year+1900,nowtimer.tm_mon,nowtimer.tm_mday,\
-             nowtimer.tm_hour,nowtimer.tm_min,nowtimer.tm_sec);
+    const struct st_snapfile &file=snapdir.vfiles[m_filepos++];
+
+    // 路径超过300字节的文件，CDirScanner已跳过，不会出现在快照中。
+    STRCPY(m_DirName,sizeof(m_DirName),snapdir.path.c_str());
+    STRCPY(m_FileName,sizeof(m_FileName),file.name.c_str());
+    SNPRINTF(m_FullFileName,sizeof(m_FullFileName),300,"%s/%s",snapdir.path.c_str(),file.name.c_str());
+
+    m_FileSize=file.filesize;
+    m_mtime=file.mtime;
+    m_inode=file.inode;
+    m_bCached=snapdir.bcached;
+
+    return true;
   }
 
-  m_pos++;
+  return false;
+}
+
+// 重新获取当前文件的信息，只有需要处理的文件才付出stat的代价。
+bool CDirSnapshot::Refresh()
+{
+  struct stat st_filestat;
+
+  if (stat(m_FullFileName,&st_filestat)!=0) return false;
+
+  m_FileSize=st_filestat.st_size;
+  m_mtime=st_filestat.st_mtime;
+  m_inode=st_filestat.st_ino;
+  m_bCached=false;
 
   return true;
 }
 
-CDir::~CDir()
+// 把本次扫描的结果写入快照文件，目录按扫描的顺序写入，与上次的快照文件一致。
+bool CDirSnapshot::SaveSnapshot()
 {
-  m_vFileName.clear();
+  if (m_snapfile.empty()==true) return false;
 
-  // m_vDirName.clear();
+  CFile File;
+
+  if (File.OpenForRename(m_snapfile.c_str(),"w")==false) return false;
+
+  File.Append(SNAPMAGIC,strlen(SNAPMAGIC));
+  SnapString(File,m_root);
+  SnapString(File,m_matchstr);
+  SnapUint32(File,m_vdirs.size());
+
+  for (size_t ii=0;ii<m_vdirs.size();ii++)
+  {
+    const struct st_snapdir &snapdir=m_vdirs[ii];
+
+    SnapString(File,snapdir.path);
+    SnapInt64(File,snapdir.mtimesec);
+    SnapInt64(File,snapdir.mtimensec);
+    SnapUint32(File,snapdir.vfiles.size());
+    SnapUint32(File,snapdir.vsubdirs.size());
+
+    for (size_t jj=0;jj<snapdir.vfiles.size();jj++)
+    {
+      const struct st_snapfile &file=snapdir.vfiles[jj];
+      SnapString(File,file.name);
+      SnapInt64(File,file.filesize);
+      SnapInt64(File,file.mtime);
+      SnapInt64(File,file.inode);
+    }
+
+    for (size_t jj=0;jj<snapdir.vsubdirs.size();jj++) SnapString(File,snapdir.vsubdirs[jj]);
+  }
+
+  return File.CloseAndRename();
 }
 
 // 删除目录中的文件，类似Linux系统的rm命令。
@@ -1933,6 +4135,8 @@ CTcpServer::~CTcpServer()
 // 返回值：true-成功；false-失败，失败有两种情况：1）等待超时；2）socket连接已不可用。
 bool TcpRead(const int sockfd,char *buffer,int *ibuflen,const int itimeout)
 {
+  PROFILE("TcpRead");
+
   if (sockfd==-1) return false;
 
   // 如果itimeout>0，表示需要等待itimeout秒，如果itimeout秒后还没有数据到达，返回false。
@@ -2141,6 +4345,232 @@ double CTimer::Elapsed()
   return dend-dstart;
 }
 
+// 获取单调时钟的时间，单位：纳秒。
+long CTimer::NowNS()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+
+  return ts.tv_sec*1000000000L+ts.tv_nsec;
+}
+
+atomic<CProfSite*> CProfiler::m_head(0);
+CLogFile* CProfiler::m_logfile=0;
+volatile sig_atomic_t CProfiler::m_sigusr1count=0;
+atomic<int> CProfiler::m_dumpcount(0);
+atomic<bool> CProfiler::m_benable(false);
+
+CProfSite::CProfSite(const char *name)
+{
+  m_name=name;
+
+  for (int ii=0;ii<PROFBUCKETS;ii++) m_buckets[ii]=0;
+  m_count=0; m_sumns=0; m_maxns=0;
+
+  // 加入链表的头部，代码块在第一次执行时构造，可能有多个线程同时构造不同的代码块。
+  m_next=CProfiler::m_head.load();
+  while (CProfiler::m_head.compare_exchange_weak(m_next,this)==false) ;
+}
+
+// 耗时在直方图中的区间，小于16纳秒的每纳秒一个区间，
+// 其它的按最高位所在的2的幂次分组，每组再按最高位之后的PROFSUBBITS位分为16个区间。
+static int ProfBucket(const unsigned long ns)
+{
+  if (ns < (1UL<<PROFSUBBITS)) return ns;
+
+  int exp=63-__builtin_clzl(ns);
+
+  return ((exp-PROFSUBBITS+1)<<PROFSUBBITS)+((ns>>(exp-PROFSUBBITS))&((1UL<<PROFSUBBITS)-1));
+}
+
+// 直方图区间的中间值，是ProfBucket的逆运算。
+static unsigned long ProfBucketValue(const int bucket)
+{
+  if (bucket < (1<<PROFSUBBITS)) return bucket;
+
+  int exp=(bucket>>PROFSUBBITS)+PROFSUBBITS-1;
+  unsigned long sub=bucket&((1<<PROFSUBBITS)-1);
+  unsigned long width=1UL<<(exp-PROFSUBBITS);
+
+  return ((1UL<<exp)+sub*width)+width/2;
+}
+
+void CProfSite::Record(const long ns)
+{
+  unsigned long uns=(ns>0)?ns:0;
+
+  m_buckets[ProfBucket(uns)].fetch_add(1,memory_order_relaxed);
+  m_count.fetch_add(1,memory_order_relaxed);
+  m_sumns.fetch_add(uns,memory_order_relaxed);
+
+  unsigned long maxns=m_maxns.load(memory_order_relaxed);
+  while ( (uns>maxns) && (m_maxns.compare_exchange_weak(maxns,uns,memory_order_relaxed)==false) ) ;
+}
+
+CProfScope::CProfScope(CProfSite *site)
+{
+  m_site=0; m_begin=0;
+
+  if (CProfiler::m_benable.load(memory_order_relaxed)==false) return;
+
+  m_site=site; m_begin=CTimer::NowNS();
+}
+
+CProfScope::~CProfScope()
+{
+  if (m_site==0) return;
+
+  m_site->Record(CTimer::NowNS()-m_begin);
+
+  if (CProfiler::m_sigusr1count!=CProfiler::m_dumpcount.load(memory_order_relaxed)) CProfiler::CheckDump();
+}
+
+void CProfiler::Sigusr1Handler(int)
+{
+  m_sigusr1count++;
+}
+
+// 开始统计耗时。
+void CProfiler::Enable(CLogFile *logfile)
+{
+  m_logfile=logfile;
+
+  if (m_logfile!=0) signal(SIGUSR1,Sigusr1Handler);
+
+  m_benable.store(true,memory_order_release);   // 其它线程看到开始统计时，m_logfile已设置好。
+}
+
+// 停止统计耗时，已统计的结果保留。
+void CProfiler::Disable()
+{
+  m_benable.store(false,memory_order_relaxed);
+}
+
+// 如果收到过SIGUSR1信号，把统计结果写入日志文件。
+void CProfiler::CheckDump()
+{
+  int sigcount=m_sigusr1count;
+  int dumpcount=m_dumpcount.load();
+
+  if (sigcount==dumpcount) return;
+
+  // 多个线程同时发现收到了信号，只有一个线程写入日志。
+  if (m_dumpcount.compare_exchange_strong(dumpcount,sigcount)==false) return;
+
+  if (m_logfile!=0) Dump(m_logfile);
+}
+
+// 从直方图中获取第percent百分位的耗时，单位：纳秒。
+long CProfiler::Percentile(const CProfSite *site,const double percent)
+{
+  unsigned long counts[PROFBUCKETS];
+  unsigned long total=0;
+
+  for (int ii=0;ii<PROFBUCKETS;ii++)
+  {
+    counts[ii]=site->m_buckets[ii].load(memory_order_relaxed); total=total+counts[ii];
+  }
+
+  if (total==0) return 0;
+
+  unsigned long target=(unsigned long)ceil(total*percent/100);
+  if (target==0) target=1;
+
+  // 取区间的中间值，但不超过最大耗时。
+  unsigned long maxns=site->m_maxns.load(memory_order_relaxed);
+  unsigned long sum=0;
+  for (int ii=0;ii<PROFBUCKETS;ii++)
+  {
+    sum=sum+counts[ii];
+    if (sum>=target) return min(ProfBucketValue(ii),maxns);
+  }
+
+  return maxns;
+}
+
+// 把每个代码块的耗时统计写入日志文件。
+void CProfiler::Dump(CLogFile *logfile,const bool breset)
+{
+  if (logfile==0) return;
+
+  logfile->Write("耗时统计（单位：微秒）：\n");
+
+  for (CProfSite *site=m_head.load();site!=0;site=site->m_next)
+  {
+    unsigned long count=site->m_count.load(memory_order_relaxed);
+    if (count==0) continue;
+
+    logfile->WriteEx("  %-24s 次数=%lu 平均=%.1f p50=%.1f p99=%.1f 最大=%.1f\n",site->m_name,count,
+                     site->m_sumns.load(memory_order_relaxed)/1000.0/count,
+                     Percentile(site,50)/1000.0,Percentile(site,99)/1000.0,
+                     site->m_maxns.load(memory_order_relaxed)/1000.0);
+
+    if (breset==false) continue;
+
+    for (int ii=0;ii<PROFBUCKETS;ii++) site->m_buckets[ii]=0;
+    site->m_count=0; site->m_sumns=0; site->m_maxns=0;
+  }
+}
+
+// splitmix64算法，state每次增加一个常数，返回混合后的值。
+static uint64_t splitmix64(uint64_t &state)
+{
+  uint64_t z=(state+=0x9E3779B97F4A7C15ULL);
+  z=(z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+  z=(z^(z>>27))*0x94D049BB133111EBULL;
+  return z^(z>>31);
+}
+
+CRandom::CRandom(const uint64_t seed)
+{
+  Seed(seed);
+}
+
+// 设置种子，用splitmix64把种子扩展为xoshiro256**的四个状态值，保证状态不全为0。
+void CRandom::Seed(const uint64_t seed)
+{
+  uint64_t state=seed;
+
+  for (int ii=0;ii<4;ii++) m_state[ii]=splitmix64(state);
+}
+
+// xoshiro256**算法。
+uint64_t CRandom::Next()
+{
+  uint64_t *s=m_state;
+
+  uint64_t x=s[1]*5;
+  uint64_t result=((x<<7)|(x>>57))*9;
+
+  uint64_t t=s[1]<<17;
+
+  s[2]^=s[0];
+  s[3]^=s[1];
+  s[1]^=s[2];
+  s[0]^=s[3];
+
+  s[2]^=t;
+  s[3]=(s[3]<<45)|(s[3]>>19);
+
+  return result;
+}
+
+// 获取[0,n)之间的随机整数，用乘法代替取模，取高32位。
+int CRandom::Rand(const int n)
+{
+  if (n<=0) return 0;
+
+  return (int)(((Next()>>32)*(uint64_t)n)>>32);
+}
+
+// 把两个整数混合成一个种子。
+uint64_t CRandom::Mix(const uint64_t a,const uint64_t b)
+{
+  uint64_t state=a^(b*0xD6E8FEB86659FD93ULL);
+
+  return splitmix64(state);
+}
+
 CSEM::CSEM()
 {
   m_semid=-1;
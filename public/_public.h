@@ -122,6 +122,58 @@ void PickNumber(const char* src,
 // rules：匹配规则的表达式，用星号"*"代表任意字符串，多个表达式之间用半角的逗号分隔，如"*.h,*.cpp"。
 // 注意：1）str参数不支持"*"，rules参数支持"*"；2）函数在判断str是否匹配rules的时候，会忽略字母的大小写。
 bool MatchStr(const string& str, const string& rules);
+
+// 预先编译的匹配规则，规则的写法与MatchStr函数相同。
+// 规则只在Compile时拆分和转换为大写一次，每条规则按星号拆分为首部、中间部分和尾部，
+// 匹配时直接比较首部和尾部，再按顺序查找中间部分，不复制字符串，不分配内存。
+// 同一个规则需要匹配大量字符串时（例如目录中的全部文件名），用CMatchRule代替MatchStr函数。
+class CMatchRule {
+   private:
+    // 一条规则，例如"*.xml"。
+    struct st_rule {
+        bool bStar;             // 规则中是否有星号，没有星号的规则必须与字符串完全相同。
+        string prefix;          // 第一个星号之前的部分，已转换为大写。
+        string suffix;          // 最后一个星号之后的部分，已转换为大写。
+        vector<string> vmiddle; // 星号之间的部分，已转换为大写，按顺序匹配。
+        size_t minlen;          // 能匹配这条规则的字符串的最小长度。
+    };
+
+    vector<struct st_rule> m_vrules;  // 全部的规则。
+    bool m_bAll;  // 是否有规则是"*"，有的话匹配任意字符串。
+
+    // 判断str开始的part.size()字节是否与part相同，忽略大小写，part已转换为大写。
+    static bool EqualUpper(const char* str, const string& part);
+
+   public:
+    CMatchRule();
+    CMatchRule(const char* rules);  // 构造函数，同时编译规则。
+
+    // 编译匹配规则。
+    // rules：匹配规则的表达式，用星号"*"代表任意字符串，多个表达式之间用半角的逗号分隔，如"*.h,*.cpp"。
+    void Compile(const char* rules);
+
+    // 判断字符串是否匹配规则，忽略字母的大小写，结果与MatchStr函数相同。
+    // str：需要判断的字符串，是精确表示的，如文件名"_public.cpp"。
+    bool Match(const char* str) const;
+};
+
+// 把整数转换为十进制的字符串，写入buffer中，不调用printf函数族，不分配内存。
+// buffer：用于存放转换结果，调用者必须保证至少有21字节的空间。
+// value：待转换的整数。
+// 返回值：写入buffer的字节数，注意，buffer的结尾不会补0。
+int FormatInt(char* buffer, long value);
+
+// 把以0.1为单位的整数转换为一位小数的字符串，写入buffer中，结果与printf("%.1f",value/10.0)相同。
+// 例如：235转换为"23.5"，-5转换为"-0.5"，100000转换为"10000.0"。
+// buffer：用于存放转换结果，调用者必须保证至少有22字节的空间。
+// value：以0.1为单位的整数，例如气温的单位是0.1摄氏度。
+// 返回值：写入buffer的字节数，注意，buffer的结尾不会补0。
+int FormatTenths(char* buffer, long value);
+
+// 从字段中解析整数，结果与atol函数相同，忽略前导的空白字符，遇到非数字字符结束。
+// field：字段的内容，不需要以0结尾，例如CCmdStr拆分出来的字段或CSV行中的一段。
+// 返回值：解析出来的整数。
+long ParseLong(string_view field);
 ///////////////////////////////////// /////////////////////////////////////
 
 // CCmdStr类用于拆分有分隔符的字符串。
@@ -129,8 +181,16 @@ bool MatchStr(const string& str, const string& rules);
 // 例如："messi,10,striker,30,1.72,68.5,Barcelona"，这是足球运动员梅西的资料，包括姓名、
 // 球衣号码、场上位置、年龄、身高、体重和效力的俱乐部，字段之间用半角的逗号分隔。
 class CCmdStr {
+   private:
+    bool m_bView;  // 最后一次拆分是否调用的SplitToView方法，GetValue方法据此决定从哪个容器获取字段内容。
+
+    // 获取第inum个字段的内容，不复制字符串。
+    // 返回值：true-成功；如果inum的取值超出了字段的个数，返回失败。
+    bool GetField(const int inum, string_view& field);
+
    public:
     vector<string> m_vCmdStr;  // 存放拆分后的字段内容。
+    vector<string_view> m_vCmdView;  // 存放SplitToView方法拆分后的字段，指向buffer中的内容。
 
     CCmdStr();  // 构造函数。
     CCmdStr(const string& buffer,
@@ -146,7 +206,14 @@ class CCmdStr {
                     const char* sepstr,
                     const bool bdelspace = false);
 
-    // 获取拆分后字段的个数，即m_vCmdStr容器的大小。
+    // 把字符串拆分到m_vCmdView容器中，参数与SplitToCmd方法相同。
+    // 拆分后的字段直接指向buffer中的内容，不复制字符串，不分配内存（容器扩容除外），删除空格也只是调整字段的起止位置。
+    // 注意：m_vCmdView中的字段在buffer的内容改变或释放之前才有效，GetValue方法也一样。
+    void SplitToView(const char* buffer,
+                     const char* sepstr,
+                     const bool bdelspace = false);
+
+    // 获取拆分后字段的个数，即m_vCmdStr或m_vCmdView容器的大小。
     int CmdCount();
 
     // 从m_vCmdStr容器获取字段内容。
@@ -162,6 +229,7 @@ class CCmdStr {
     bool GetValue(const int inum, unsigned long* value);  // unsigned long整数。
     bool GetValue(const int inum, double* value);         // 双精度double。
     bool GetValue(const int inum, bool* value);           // bool型。
+    bool GetValue(const int inum, string_view* value);    // 不复制字符串，字段的有效期与拆分的buffer相同。
 
     ~CCmdStr();  // 析构函数。
 };
@@ -195,6 +263,142 @@ bool GetXMLBuffer(const char* xmlbuffer,
                   const char* fieldname,
                   unsigned long* value);
 bool GetXMLBuffer(const char* xmlbuffer, const char* fieldname, double* value);
+
+// 从xml格式的字符串中查找字段的内容，查找规则与GetXMLBuffer函数相同，不复制字符串。
+// value：字段内容在xmlbuffer中的位置和长度，未删除前后的空格。
+// 返回值：true-成功；如果fieldname参数指定的标签名不存在，返回失败。
+bool FindXMLField(const char* xmlbuffer, const char* fieldname, string_view* value);
+
+// 解析一条xml格式的记录，例如<obtid>58015</obtid><t>28.5</t>...<endl/>。
+// 调用Parse方法扫描一次记录，把每个字段的标签名和内容的位置存放在索引中，之后按标签名获取字段的内容时，
+// 只查找索引，不再从头扫描记录，适用于从同一条记录中获取多个字段的场景。
+// 获取字段内容的规则与GetXMLBuffer函数相同，如果记录中有字段嵌套在其它字段的内容中，
+// 不使用索引，按GetXMLBuffer函数的规则从记录中查找。
+// 注意，索引只存放位置，不复制记录的内容，在获取字段期间，xmlbuffer的内容不能改变或释放。
+class CXMLRecord {
+   private:
+    struct st_xmlfield {
+        string_view name;   // 字段的标签名。
+        string_view value;  // 字段的内容，未删除前后的空格。
+    };
+
+    const char* m_xmlbuffer;          // 最后一次解析的记录。
+    vector<st_xmlfield> m_vfields;    // 字段的索引，按字段在记录中出现的顺序存放。
+    bool m_bNested;                   // 是否有字段的内容中嵌套了标签。
+
+    // 获取字段的内容，不复制字符串。
+    bool Find(const char* fieldname, string_view& value) const;
+
+   public:
+    CXMLRecord();
+    CXMLRecord(const char* xmlbuffer);
+
+    // 扫描一条记录，生成字段的索引，返回字段的个数。
+    // 只索引<name>value</name>形式的字段，<endl/>之类的空标签和没有结束标签的字段被忽略，
+    // 字段的内容中嵌套的标签不索引。
+    int Parse(const char* xmlbuffer);
+
+    // 获取字段的个数。
+    int FieldCount() const { return m_vfields.size(); }
+
+    // 获取字段的内容，参数和返回值与GetXMLBuffer函数相同。
+    bool GetValue(const char* fieldname, char* value, const int ilen = 0) const;
+    bool GetValue(const char* fieldname, bool* value) const;
+    bool GetValue(const char* fieldname, int* value) const;
+    bool GetValue(const char* fieldname, unsigned int* value) const;
+    bool GetValue(const char* fieldname, long* value) const;
+    bool GetValue(const char* fieldname, unsigned long* value) const;
+    bool GetValue(const char* fieldname, double* value) const;
+    bool GetValue(const char* fieldname, string_view* value) const;  // 不复制字符串，已删除前后的空格。
+};
+///////////////////////////////////// /////////////////////////////////////
+
+///////////////////////////////////// /////////////////////////////////////
+// 生成xml、json或csv格式字符串的类，是GetXMLBuffer函数的逆操作。
+// 内容存放在内部的缓冲区中，缓冲区按倍数扩容，Clear后保留已分配的内存，重复使用时不再分配内存，
+// 整数和小数直接转换到缓冲区中，不调用printf函数族（AddField的double参数除外），没有长度限制。
+// 每种格式生成的内容如下：
+// 1）xml：<name>value</name>，一条记录以<endl/>和换行结束；
+// 2）json：{"name":"value",...}，记录之间用逗号分隔，字段的内容都用双引号括起来，双引号等特殊字符会被转义；
+// 3）csv：value,value,...，字段名被忽略，一条记录以换行结束。
+// 用法示例：
+//   CStrBuilder xml;
+//   xml.AddField("retcode",0); xml.AddField("message","成功。");
+//   TcpWrite(sockfd,xml.c_str(),xml.Length());   // <retcode>0</retcode><message>成功。</message>
+
+#define STRB_XML 1   // xml格式。
+#define STRB_JSON 2  // json格式。
+#define STRB_CSV 3   // csv格式。
+
+class CStrBuilder {
+   private:
+    vector<char> m_buffer;  // 缓冲区，容器的大小就是缓冲区的容量，生成的内容之后总是有一个0。
+    size_t m_len;           // 生成的内容的长度。
+    int m_format;           // 格式，取值为STRB_XML、STRB_JSON或STRB_CSV。
+    char m_sep;             // csv格式字段之间的分隔符。
+    int m_fieldcount;       // 当前记录已添加的字段数。
+    long m_recordcount;     // 已结束的记录数。
+
+    // 确保内容之后还有n+1字节的空间，不够时按倍数扩容，返回写入的位置。
+    char* Grow(const size_t n);
+
+    // 已在Grow返回的位置写入了n字节，调整内容的长度，并在结尾补0。
+    void Commit(const size_t n);
+
+    void Put(const char* str, const size_t len);  // 追加len字节的内容。
+    // 在pos写入字段内容之前的部分，例如<name>、,"name":"，返回写入后的位置，调用者保证空间足够。
+    char* FieldPrefix(char* pos, const char* name, const size_t namelen);
+
+    // 在pos写入字段内容之后的部分，例如</name>、"，返回写入后的位置，调用者保证空间足够。
+    char* FieldSuffix(char* pos, const char* name, const size_t namelen);
+
+    void AppendValue(string_view value);  // 写入字段的内容，json格式要转义。
+
+   public:
+    // format：格式，缺省是xml。
+    // capacity：缓冲区的初始大小，单位：字节，内容超过后自动扩容。
+    CStrBuilder(const int format = STRB_XML, const size_t capacity = 1024);
+
+    // 设置格式，sep是csv格式字段之间的分隔符，缺省是逗号。设置格式会清空已生成的内容。
+    void SetFormat(const int format, const char sep = ',');
+
+    // 清空已生成的内容和记录数，开始生成新的字符串，已分配的内存保留。
+    void Clear();
+
+    // 只清空已生成的内容，记录数不变，用于分段写出很大的字符串，例如每生成64K就写入文件。
+    void ClearBuffer();
+
+    // 预先分配缓冲区，capacity是预计生成内容的最大长度，单位：字节。
+    void Reserve(const size_t capacity);
+
+    // 开始一条记录，json格式会写入记录之间的逗号和左花括号。
+    void BeginRecord();
+
+    // 结束一条记录，xml格式写入<endl/>和换行，json格式写入右花括号，csv格式写入换行。
+    void EndRecord();
+
+    // 添加一个字段。
+    // name：字段名，csv格式忽略。
+    // value：字段的内容，支持字符串、int、long和double。
+    void AddField(const char* name, const char* value);
+    void AddField(const char* name, string_view value);
+    void AddField(const char* name, const int value);
+    void AddField(const char* name, const long value);
+    void AddField(const char* name, const double value, const int digits = 2);  // digits：小数的位数。
+
+    // 添加一个以0.1为单位的整数字段，内容与"%.1f"格式的value/10.0相同，例如235添加为23.5。
+    void AddTenths(const char* name, const long value);
+
+    // 原样追加内容，不加字段名和分隔符，用于写入文件头、文件尾之类的内容。
+    void Append(string_view str);
+    void AppendChar(const char chr);
+
+    // 获取生成的内容。
+    string_view View() const { return string_view(m_buffer.data(), m_len); }
+    const char* c_str() const { return m_buffer.data(); }
+    size_t Length() const { return m_len; }
+    long RecordCount() const { return m_recordcount; }
+};
 ///////////////////////////////////// /////////////////////////////////////
 
 ///////////////////////////////////// /////////////////////////////////////
@@ -226,13 +430,23 @@ void LocalTime(char* stime, const char* fmt = 0, const int timetvl = 0);
 // ltime：整数表示的时间。
 // stime：字符串表示的时间。
 // fmt：输出字符串时间stime的格式，与LocalTime函数的fmt参数相同，如果fmt的格式不正确，stime将为空。
+// 注意：本函数是线程安全的，每个线程缓存最近一次转换的结果，同一秒内用相同的格式多次转换只格式化一次，
+//       LocalTime、AddTime和CDir::ReadDir都调用本函数，写日志和扫描目录时不必每次调用localtime。
 void timetostr(const time_t ltime, char* stime, const char* fmt = 0);
 
 // 把字符串表示的时间转换为整数表示的时间。
 // stime：字符串表示的时间，格式不限，但一定要包括yyyymmddhh24miss，一个都不能少，顺序也不能变。
 // 返回值：整数表示的时间，如果stime的格式不正确，返回-1。
+// 注意：本函数是线程安全的，用整数运算换算，时区偏移按天缓存在线程中，只有遇到新的日期时才调用mktime。
 time_t strtotime(const char* stime);
 
+// 把多个字符串表示的时间转换为整数表示的时间，与逐个调用strtotime的结果相同。
+// stimes：字符串表示的时间的数组，每个时间的格式与strtotime函数的stime参数相同。
+// ltimes：用于存放整数表示的时间的数组，大小不能小于count，格式不正确的时间为-1。
+// count：时间的个数。
+// 返回值：转换成功的个数。
+int strtotime(const char* const stimes[], time_t ltimes[], const int count);
+
 // 把字符串表示的时间加上一个偏移的秒数后得到一个新的字符串表示的时间。
 // in_stime：输入的字符串格式的时间，格式不限，但一定要包括yyyymmddhh24miss，一个都不能少，顺序也不能变。
 // out_stime：输出的字符串格式的时间。
@@ -261,9 +475,117 @@ class CTimer {
     // 计算已逝去的时间，单位：秒，小数点后面是微秒。
     // 每调用一次本方法之后，自动调用Start方法重新开始计时。
     double Elapsed();
+
+    // 获取单调时钟的时间，单位：纳秒，不受修改系统时间的影响，用于计算很短的耗时。
+    static long NowNS();
+};
+
+// 热点代码耗时的统计，在需要统计的代码块开头写上PROFILE("名称")，代码块结束时记录耗时。
+// 每个代码块的耗时记录在一个对数线性的直方图中，每个2的幂次分为16个区间，误差不超过6%，
+// 记录时只有几次原子操作，不加锁，多个线程同时执行同一个代码块也不影响。
+// 缺省不统计，调用CProfiler::Enable后才开始统计；进程收到SIGUSR1信号后，
+// 把每个代码块的调用次数和耗时的p50、p99和最大值写入日志文件，例如：kill -USR1 进程编号
+#define PROFSUBBITS 4                                // 每个2的幂次分为2^PROFSUBBITS个区间。
+#define PROFBUCKETS ((64 - PROFSUBBITS) << PROFSUBBITS)  // 直方图区间的个数。
+
+// 一个代码块的耗时统计，用PROFILE宏定义，不需要直接使用。
+class CProfSite {
+   private:
+    const char* m_name;                            // 代码块的名称。
+    atomic<unsigned long> m_buckets[PROFBUCKETS];  // 直方图每个区间的调用次数。
+    atomic<unsigned long> m_count;                 // 调用次数。
+    atomic<unsigned long> m_sumns;                 // 总耗时，单位：纳秒。
+    atomic<unsigned long> m_maxns;                 // 最大耗时，单位：纳秒。
+    CProfSite* m_next;                             // 全部代码块组成的链表。
+
+    friend class CProfiler;
+
+   public:
+    CProfSite(const char* name);  // 构造函数中把自己加入CProfiler的链表。
+
+    // 记录一次调用的耗时，单位：纳秒。
+    void Record(const long ns);
+};
+
+// 统计一个代码块的耗时，构造时开始计时，析构时记录，用PROFILE宏定义，不需要直接使用。
+class CProfScope {
+   private:
+    CProfSite* m_site;  // 代码块的耗时统计，没有开始统计时为0。
+    long m_begin;       // 开始的时间，单位：纳秒。
+
+   public:
+    CProfScope(CProfSite* site);
+    ~CProfScope();
+};
+
+#define PROFILECAT2(a, b) a##b
+#define PROFILECAT(a, b) PROFILECAT2(a, b)
+#define PROFILE(name)                                              \
+    static CProfSite PROFILECAT(profsite, __LINE__)(name);         \
+    CProfScope PROFILECAT(profscope, __LINE__)(&PROFILECAT(profsite, __LINE__))
+
+class CLogFile;
+
+// 全部代码块耗时统计的管理，只有静态成员。
+class CProfiler {
+   private:
+    static atomic<CProfSite*> m_head;               // 全部代码块组成的链表。
+    static CLogFile* m_logfile;                     // 收到SIGUSR1信号后写入的日志文件。
+    static volatile sig_atomic_t m_sigusr1count;    // 收到SIGUSR1信号的次数。
+    static atomic<int> m_dumpcount;                 // 已写入日志时收到的信号次数。
+    static void Sigusr1Handler(int);
+
+    static atomic<bool> m_benable;  // 是否统计耗时，任何线程都会读取，用原子变量。
+
+    friend class CProfSite;
+    friend class CProfScope;
+
+   public:
+    // 开始统计耗时。
+    // logfile：收到SIGUSR1信号后写入的日志文件，为0时不处理SIGUSR1信号，只能调用Dump方法写入。
+    // 注意：信号处理函数中不能写日志，收到SIGUSR1信号后，在下一个被统计的代码块结束时或调用CheckDump时写入。
+    static void Enable(CLogFile* logfile = 0);
+
+    // 停止统计耗时，已统计的结果保留。
+    static void Disable();
+
+    // 如果收到过SIGUSR1信号，把统计结果写入日志文件，可以在程序的主循环中调用。
+    static void CheckDump();
+
+    // 把每个代码块的调用次数、平均耗时、p50、p99和最大耗时写入日志文件，耗时的单位是微秒。
+    // breset：写入后是否清空统计结果，缺省不清空。
+    static void Dump(CLogFile* logfile, const bool breset = false);
+
+    // 从直方图中获取第percent百分位的耗时，单位：纳秒，取区间的中间值（不超过最大耗时），没有调用记录返回0。
+    static long Percentile(const CProfSite* site, const double percent);
 };
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
+///////////////////////////////////// /////////////////////////////////////
+// 快速的伪随机数生成器，采用xoshiro256**算法，用splitmix64算法把种子扩展为内部状态。
+// 与rand函数不同，每个对象有自己的状态，多线程中每个线程使用自己的对象，不需要加锁；
+// 相同的种子生成的随机数序列完全相同，可以用于生成可重现的测试数据。
+class CRandom {
+   private:
+    uint64_t m_state[4];  // 内部状态。
+
+   public:
+    CRandom(const uint64_t seed = 0);  // 构造函数中会调用Seed方法。
+
+    // 设置种子，重新开始随机数序列。
+    void Seed(const uint64_t seed);
+
+    // 获取下一个64位的随机数。
+    uint64_t Next();
+
+    // 获取[0,n)之间的随机整数，n必须大于0。
+    int Rand(const int n);
+
+    // 把多个整数混合成一个种子，用于为每个数据单元（如每个站点）生成独立的随机数序列。
+    static uint64_t Mix(const uint64_t a, const uint64_t b);
+};
+///////////////////////////////////// /////////////////////////////////////
+
 ///////////////////////////////////// /////////////////////////////////////
 // 目录操作相关的类
 
@@ -305,16 +627,27 @@ class CDir {
     // in_MaxCount，获取文件的最大数量，缺省值为10000个。
     // bAndChild，是否打开各级子目录，缺省值为false-不打开子目录。
     // bSort，是否对获取到的文件列表（即m_vFileName容器中的内容）进行排序，缺省值为false-不排序。
-    // 返回值：true-成功，false-失败，如果in_DirName参数指定的目录不存在，OpenDir方法会创建该目录，如果创建失败，返回false，如果当前用户对in_DirName目录下的子目录没有读取权限也会返回false。
+    // threads，扫描子目录的线程数，缺省值为1，bAndChild为true且threads大于1时用CDirWalker扫描。
+    // 返回值：true-成功，false-失败，如果in_DirName参数指定的目录不存在，OpenDir方法会创建该目录，如果创建失败，返回false，没有读取权限的子目录被跳过。
+    // 注意：OpenDir把全部的文件名存放在容器中，文件很多的目录请使用CDirScanner，不限制文件的数量。
     bool OpenDir(const char* in_DirName,
                  const char* in_MatchStr,
                  const unsigned int in_MaxCount = 10000,
                  const bool bAndChild = false,
-                 bool bSort = false);
+                 bool bSort = false,
+                 const int threads = 1);
+
+    // 打开目录，匹配规则已预先编译，其它参数与上一个OpenDir方法相同。
+    bool OpenDir(const char* in_DirName,
+                 const CMatchRule& in_MatchRule,
+                 const unsigned int in_MaxCount = 10000,
+                 const bool bAndChild = false,
+                 bool bSort = false,
+                 const int threads = 1);
 
-    // 这是一个递归函数，被OpenDir()的调用，在CDir类的外部不需要调用它。
+    // 被OpenDir()调用，用CDirScanner扫描目录，在CDir类的外部不需要调用它。
     bool _OpenDir(const char* in_DirName,
-                  const char* in_MatchStr,
+                  const CMatchRule& in_MatchRule,
                   const unsigned int in_MaxCount,
                   const bool bAndChild);
 
@@ -326,6 +659,260 @@ class CDir {
     ~CDir();  // 析构函数。
 };
 
+// 流式的目录扫描器，每调用一次ReadDir方法返回一个文件，不限制文件的数量，也不把文件清单全部存放在内存中。
+// 用getdents64系统调用读取目录项，根据目录项的类型（d_type）判断是否是目录，文件名不匹配的文件不获取文件信息；
+// 子目录用openat打开，文件信息用fstatat获取，都相对于目录的文件描述符，不需要拼接路径，也不必逐级解析路径。
+// 与CDir相比，不排序，文件的顺序是目录项在目录中的顺序，扫描过程中目录的变化可能被看到也可能不被看到。
+class CDirScanner {
+   private:
+    // 一级正在扫描的目录。
+    struct st_dirframe {
+        int fd;               // 目录的文件描述符。
+        size_t pathlen;       // 目录名（以'/'结尾）在m_path中的长度。
+        vector<char> buffer;  // 用getdents64读取的目录项。
+        int bpos;             // buffer中下一个目录项的位置。
+        int blen;             // buffer中目录项的总字节数。
+    };
+
+    vector<struct st_dirframe> m_frames;  // 正在扫描的各级目录，最后一个是当前目录。
+    string m_path;                        // 当前目录的目录名，以'/'结尾。
+    CMatchRule m_MatchRule;               // 文件名的匹配规则。
+    bool m_bAndChild;                     // 是否扫描各级子目录。
+    long m_count;                         // 已返回的文件数。
+    long m_errcount;                      // 无法打开的子目录和无法获取信息的文件数。
+    vector<string>* m_psubdirs;           // 不为0时不进入子目录，而是把子目录名存放在其中，由SetSubDirs方法设置。
+
+    // 打开一级目录，放入m_frames中，dirfd是上级目录的文件描述符，name是目录名，dirfd为AT_FDCWD时name是完整的目录名。
+    bool PushDir(const int dirfd, const char* name);
+
+    // 关闭当前目录，返回到上级目录。
+    void PopDir();
+
+   public:
+    char m_DirName[301];       // 目录名，例如：/tmp/root。
+    char m_FileName[301];      // 文件名，不包括目录名，例如：data.xml。
+    char m_FullFileName[301];  // 文件全名，包括目录名，例如：/tmp/root/data.xml，超过300字节的文件被跳过，计入ErrCount。
+    long m_FileSize;           // 文件的大小，单位：字节。
+    time_t m_mtime;            // 文件最后一次被修改的时间，即stat结构体的st_mtime成员。
+    time_t m_ctime;            // 文件状态最后一次改变的时间，即stat结构体的st_ctime成员。
+    time_t m_atime;            // 文件最后一次被访问的时间，即stat结构体的st_atime成员。
+    ino_t m_inode;             // 文件的inode号，即stat结构体的st_ino成员。
+    char m_ModifyTime[21];     // m_mtime的字符串格式，格式由SetDateFMT方法设置，没有设置格式时为空，不转换。
+    char m_DateFMT[25];        // 文件时间显示格式，由SetDateFMT方法设置，缺省为空。
+
+    CDirScanner();
+    ~CDirScanner();  // 析构函数中会调用CloseDir方法。
+
+    // 设置m_ModifyTime的格式，与LocalTime函数的fmt参数相同，只比较文件时间时不必设置，直接比较m_mtime更快。
+    void SetDateFMT(const char* in_DateFMT);
+
+    // 设置存放子目录名的容器，设置后bAndChild为true时不进入子目录，而是把子目录的完整路径追加到psubdirs中，
+    // 由调用者决定如何扫描子目录，例如CDirWalker把子目录分给多个线程，psubdirs为0时恢复逐级进入子目录。
+    void SetSubDirs(vector<string>* psubdirs);
+
+    // 打开目录，准备扫描。
+    // in_DirName：待打开的目录名，采用绝对路径，如/tmp/root。
+    // in_MatchStr：待获取文件名的匹配规则，不匹配的文件被忽略，具体请参见开发框架的MatchStr函数。
+    // bAndChild：是否扫描各级子目录，缺省值为false-不扫描子目录。
+    // bCreate：目录不存在时是否创建该目录，缺省值为true-创建；扫描已列出的子目录时应该填false，
+    //          子目录可能已被其它程序删除，不能再创建出来。
+    // 返回值：true-成功，false-失败，目录不存在又没有创建（或创建失败）或没有读取权限。
+    bool OpenDir(const char* in_DirName, const char* in_MatchStr, const bool bAndChild = false, const bool bCreate = true);
+
+    // 打开目录，匹配规则已预先编译，其它参数与上一个OpenDir方法相同。
+    bool OpenDir(const char* in_DirName, const CMatchRule& in_MatchRule, const bool bAndChild = false, const bool bCreate = true);
+
+    // 获取下一个文件，同时获取该文件的大小、修改时间等信息。
+    // 返回值：true-成功；false-已扫描完全部的文件，扫描完后自动关闭目录。
+    // 无法打开的子目录和无法获取信息的文件被跳过，计入ErrCount，不影响其它文件的扫描。
+    bool ReadDir();
+
+    // 重新获取当前文件的大小和时间等信息，在处理文件（例如删除、压缩）之前确认文件的最新状态。
+    // 返回值：true-成功；false-文件已不存在。
+    bool Refresh();
+
+    // 关闭全部已打开的目录。
+    void CloseDir();
+
+    long Count() const { return m_count; }        // 获取已返回的文件数。
+    long ErrCount() const { return m_errcount; }  // 获取被跳过的子目录和文件数。
+};
+
+// 多线程的目录扫描器，用于子目录很多的目录（例如按日期分区的归档目录），扫描时耗时主要在等待读取目录和文件信息上。
+// 每个线程有自己的待扫描目录队列，扫描一个目录时发现的子目录放入自己的队列，自己的队列空了就从其它线程的队列中取，
+// 每个线程用CDirScanner扫描目录，扫描结果先存放在线程自己的容器中，全部扫描完后合并；需要排序时，
+// 各线程先对自己的结果排序，再由多个线程两两归并。扫描完后用ReadDir方法逐个获取文件，不需要再获取文件信息。
+class CDirWalker {
+   private:
+    // 一个文件的信息。
+    struct st_walkfile {
+        string filename;  // 文件全名，包括目录名。
+        long filesize;    // 文件的大小，单位：字节。
+        time_t mtime;     // 文件最后一次被修改的时间。
+    };
+
+    // 一个线程的待扫描目录队列，本线程从尾部取，其它线程从头部取。
+    struct st_walkqueue {
+        pthread_mutex_t mutex;  // 队列的锁。
+        deque<string> dirs;     // 待扫描的目录。
+    };
+
+    // 线程函数的参数。
+    struct st_walkarg {
+        CDirWalker* walker;  // 扫描器。
+        int id;              // 线程的序号，从0开始。
+    };
+
+    // 归并线程的参数，把first和second归并到result中。
+    struct st_walkmerge {
+        vector<struct st_walkfile>* first;
+        vector<struct st_walkfile>* second;
+        vector<struct st_walkfile>* result;
+    };
+
+    vector<struct st_walkqueue> m_queues;         // 每个线程的待扫描目录队列。
+    vector<vector<struct st_walkfile>> m_parts;   // 每个线程的扫描结果。
+    vector<struct st_walkfile> m_vFiles;          // 合并后的扫描结果。
+    size_t m_pos;                                 // ReadDir方法读取m_vFiles的位置。
+    atomic<long> m_pending;                       // 已放入队列但还没有扫描完的目录数，为0时扫描结束。
+    atomic<long> m_count;                         // 已找到的文件数，只在限制文件数时统计。
+    atomic<long> m_errcount;                      // 被跳过的子目录和文件数。
+    CMatchRule m_MatchRule;                       // 文件名的匹配规则。
+    unsigned int m_maxcount;                      // 最多获取的文件数，0表示不限制。
+    bool m_bSort;                                 // 是否排序。
+
+    static void* WalkThread(void* arg);  // 扫描线程的主函数。
+    static void* MergeThread(void* arg);  // 归并线程的主函数。
+
+    // 扫描线程id的工作：反复取出一个目录并扫描，直到全部的目录都扫描完。
+    void Walk(const int id);
+
+    // 取出一个待扫描的目录，先从自己的队列的尾部取，没有的话从其它线程的队列的头部取。
+    bool PopDir(const int id, string& dirname);
+
+    // 合并各线程的扫描结果，需要排序时用多个线程两两归并。
+    void MergeParts();
+
+   public:
+    char m_DirName[301];       // 目录名，例如：/tmp/root。
+    char m_FileName[301];      // 文件名，不包括目录名，例如：data.xml。
+    char m_FullFileName[301];  // 文件全名，包括目录名，例如：/tmp/root/data.xml。
+    long m_FileSize;           // 文件的大小，单位：字节。
+    time_t m_mtime;            // 文件最后一次被修改的时间。
+    char m_ModifyTime[21];     // m_mtime的字符串格式，格式由SetDateFMT方法设置，没有设置格式时为空，不转换。
+    char m_DateFMT[25];        // 文件时间显示格式，由SetDateFMT方法设置，缺省为空。
+
+    CDirWalker();
+
+    // 设置m_ModifyTime的格式，与LocalTime函数的fmt参数相同。
+    void SetDateFMT(const char* in_DateFMT);
+
+    // 用多个线程扫描目录及其各级子目录，扫描完后才返回。
+    // in_DirName：待扫描的目录名，采用绝对路径，如果目录不存在，会创建该目录。
+    // in_MatchStr：待获取文件名的匹配规则，不匹配的文件被忽略，具体请参见开发框架的MatchStr函数。
+    // threads：线程数，小于1时取1。
+    // bSort：是否按文件全名排序，缺省值为false-不排序，不排序时文件的顺序不确定。
+    // in_MaxCount：获取文件的最大数量，缺省值为0-不限制。
+    // 返回值：true-成功，false-失败，目录不存在又创建失败或没有读取权限，没有读取权限的子目录被跳过，计入ErrCount。
+    bool OpenDir(const char* in_DirName, const char* in_MatchStr, const int threads,
+                 const bool bSort = false, const unsigned int in_MaxCount = 0);
+
+    // 打开目录，匹配规则已预先编译，其它参数与上一个OpenDir方法相同。
+    bool OpenDir(const char* in_DirName, const CMatchRule& in_MatchRule, const int threads,
+                 const bool bSort = false, const unsigned int in_MaxCount = 0);
+
+    // 获取下一个文件的信息，返回值：true-成功；false-已获取完全部的文件。
+    bool ReadDir();
+
+    // 重新获取当前文件的大小和修改时间，文件信息是扫描时获取的，处理文件之前应该调用本方法确认。
+    // 返回值：true-成功；false-文件已不存在。
+    bool Refresh();
+
+    long Count() const { return m_vFiles.size(); }  // 获取找到的文件数。
+    long ErrCount() const { return m_errcount; }    // 获取被跳过的子目录和文件数。
+};
+
+// 增量的目录扫描器，把扫描结果（每个目录的修改时间、目录中的文件和子目录）保存在快照文件中，
+// 下次扫描时，修改时间没有变化的目录直接使用快照中的内容，不读取目录项，也不获取文件信息，
+// 只有增加、删除或改名过文件的目录才重新扫描，扫描的耗时与变化的目录数成正比，而不是与文件总数成正比。
+// 注意：
+// 1）修改文件的内容不会改变目录的修改时间，快照中的文件大小和修改时间可能已经过时，ReadDir方法返回的是快照中的值，
+//    m_bCached为true，对文件进行处理（例如删除）之前，应该调用Refresh方法重新获取该文件的信息；
+// 2）在扫描前1秒之内修改过的目录，快照中不记录它的修改时间，下次一定重新扫描，避免同一秒内的修改被漏掉；
+// 3）快照文件与目录名和匹配规则对应，目录名或匹配规则变化后，快照文件作废，重新全部扫描。
+class CDirSnapshot {
+   private:
+    // 快照中的一个文件。
+    struct st_snapfile {
+        string name;    // 文件名，不包括目录名。
+        long filesize;  // 文件的大小，单位：字节。
+        time_t mtime;   // 文件最后一次被修改的时间。
+        ino_t inode;    // 文件的inode号。
+    };
+
+    // 快照中的一个目录。
+    struct st_snapdir {
+        string path;                        // 目录名，不以'/'结尾。
+        long mtimesec;                      // 目录的修改时间的秒数，为0表示下次一定重新扫描。
+        long mtimensec;                     // 目录的修改时间的纳秒数。
+        vector<struct st_snapfile> vfiles;  // 目录中能匹配上的文件。
+        vector<string> vsubdirs;            // 子目录名，包括上级目录名，不以'/'结尾。
+        bool bcached;                       // 本次扫描是否直接使用了快照中的内容。
+    };
+
+    string m_snapfile;                     // 快照文件名。
+    string m_root;                         // 扫描的目录名，不以'/'结尾。
+    string m_matchstr;                     // 文件名的匹配规则。
+    vector<struct st_snapdir> m_vdirs;     // 本次扫描的结果。
+    size_t m_dirpos;                       // ReadDir方法读取m_vdirs的位置。
+    size_t m_filepos;                      // ReadDir方法读取m_vdirs[m_dirpos].vfiles的位置。
+    long m_count;                          // 找到的文件数。
+    long m_cachedcount;                    // 直接使用快照的目录数。
+    long m_scancount;                      // 重新扫描的目录数。
+    long m_errcount;                       // 被跳过的子目录和文件数。
+
+    // 从快照文件中加载上次扫描的结果，快照文件不存在、格式不正确或与目录名和匹配规则不对应时返回false。
+    bool LoadSnapshot(unordered_map<string, struct st_snapdir>& mdirs);
+
+    // 扫描一个目录，结果存放在snapdir中，bCreate：目录不存在时是否创建。
+    // 返回值：true-成功；false-目录无法打开。
+    bool ScanDir(const CMatchRule& MatchRule, struct st_snapdir& snapdir, const bool bCreate);
+
+   public:
+    char m_DirName[301];       // 目录名，例如：/tmp/root。
+    char m_FileName[301];      // 文件名，不包括目录名，例如：data.xml。
+    char m_FullFileName[301];  // 文件全名，包括目录名，例如：/tmp/root/data.xml。
+    long m_FileSize;           // 文件的大小，单位：字节。
+    time_t m_mtime;            // 文件最后一次被修改的时间。
+    ino_t m_inode;             // 文件的inode号。
+    bool m_bCached;            // 文件信息是否来自快照，为true时m_FileSize和m_mtime可能已过时。
+
+    CDirSnapshot();
+
+    // 扫描目录及其各级子目录，只重新扫描快照中修改时间有变化的目录，扫描完后才返回。
+    // in_DirName：待扫描的目录名，采用绝对路径，如果目录不存在，会创建该目录。
+    // in_MatchStr：待获取文件名的匹配规则，不匹配的文件被忽略，具体请参见开发框架的MatchStr函数。
+    // in_SnapFile：快照文件名，不存在时全部扫描。
+    // 返回值：true-成功，false-失败，目录不存在又创建失败或没有读取权限。
+    // 注意：OpenDir方法不写快照文件，处理完文件后调用SaveSnapshot方法。
+    bool OpenDir(const char* in_DirName, const char* in_MatchStr, const char* in_SnapFile);
+
+    // 获取下一个文件的信息，返回值：true-成功；false-已获取完全部的文件。
+    bool ReadDir();
+
+    // 重新获取当前文件的大小和修改时间，m_bCached改为false，返回值：true-成功；false-文件已不存在。
+    bool Refresh();
+
+    // 把本次扫描的结果写入快照文件，先写入临时文件，再改名，写入失败不会破坏原来的快照文件。
+    // 处理文件时删除或压缩了文件，所在目录的修改时间会变化，下次扫描时会重新扫描这些目录。
+    bool SaveSnapshot();
+
+    long Count() const { return m_count; }              // 获取找到的文件数。
+    long CachedCount() const { return m_cachedcount; }  // 获取直接使用快照的目录数。
+    long ScanCount() const { return m_scancount; }      // 获取重新扫描的目录数。
+    long ErrCount() const { return m_errcount; }        // 获取被跳过的子目录和文件数。
+};
+
 ///////////////////////////////////// /////////////////////////////////////
 
 ///////////////////////////////////// /////////////////////////////////////
@@ -394,6 +981,8 @@ bool FGETS(const FILE* fp,
            const int readsize,
            const char* endbz = 0);
 
+#define CFILE_APPENDSIZE 8192  // CFile类Append系列方法的写缓冲区的大小。
+
 // 文件操作类声明
 class CFile {
    private:
@@ -401,10 +990,34 @@ class CFile {
     bool m_bEnBuffer;  // 是否启用缓冲，true-启用；false-不启用，缺省是启用。
     char m_filename[301];  // 文件名，建议采用绝对路径的文件名。
     char m_filenametmp[301];  // 临时文件名，在m_filename后加".tmp"。
+    char* m_abuffer;  // Append系列方法的写缓冲区，第一次调用Append系列方法时才分配，大小是CFILE_APPENDSIZE。
+    int m_abuflen;  // 写缓冲区中已存放的字节数。
+    bool m_bGzip;  // 是否以gzip格式压缩写入，由OpenGzipForRename方法设置。
+    bool m_bWriteErr;  // 写入文件或压缩时是否出现过错误，出现过错误的临时文件不能改名。
+    z_stream* m_zstream;  // gzip压缩的数据流，OpenGzipForRename方法分配，结束压缩时释放。
+
+    // 把内容写入文件，如果是gzip压缩写入，先压缩再写入。
+    // 返回值：成功写入的字节数（压缩前），写入失败时置m_bWriteErr为true。
+    size_t WriteOut(const void* ptr, size_t size);
+
+    // 结束gzip压缩，把压缩数据流中剩余的内容和gzip文件尾写入文件。
+    // 返回值：true-成功；false-失败。
+    bool GzipFinish();
+
+    // 释放gzip压缩的数据流。
+    void GzipRelease();
+
+    // 为Append系列方法准备len字节的空间，空间不足时先把写缓冲区中的内容写入文件。
+    // 返回值：写缓冲区中可写入的位置。
+    char* AppendReserve(const int len);
 
    public:
     CFile();  // 构造函数。
 
+    // 持有文件指针和写缓冲区，不能复制。
+    CFile(const CFile&) = delete;
+    CFile& operator=(const CFile&) = delete;
+
     bool IsOpened();  // 判断文件是否已打开，返回值：true-已打开；false-未打开。
 
     // 打开文件。
@@ -425,11 +1038,32 @@ class CFile {
                        const char* openmode,
                        bool bEnBuffer = true);
     // 关闭文件指针，并把OpenForRename方法打开的临时文件名重命名为filename。
+    // 如果写入过程中出现过错误（例如磁盘空间不足），删除临时文件，返回false，不会留下不完整的文件。
     bool CloseAndRename();
 
+    // 专为重命名而打开文件，写入的内容用zlib压缩成gzip格式，不需要再调用gzip程序压缩。
+    // filename：压缩后的文件名，一般以".gz"结尾，打开的是filename后加".tmp"的临时文件。
+    // level：压缩级别，1-9，1最快，9压缩率最高，缺省是6，与gzip程序相同。
+    // 注意：
+    // 1）只能写入，不能用Fgets、FFGETS和Fread方法读取；
+    // 2）写入的内容在关闭文件时才完整，必须调用CloseAndRename方法，Close方法会删除临时文件。
+    bool OpenGzipForRename(const char* filename, const int level = 6);
+
     // 调用fprintf向文件写入数据，参数与fprintf库函数相同，但不需要传入文件指针。
     void Fprintf(const char* fmt, ...);
 
+    // 以下是Append系列方法，把内容追加到写缓冲区中，写缓冲区满了再写入文件，不调用printf函数族。
+    // 生成大量记录的数据文件时，用Append系列方法代替Fprintf方法。
+    // Append系列方法与Fprintf、Fwrite方法可以混用，写入文件的内容的顺序与调用的顺序相同。
+    void Append(const char* str);                   // 追加字符串。
+    void Append(const char* str, const int len);    // 追加len字节的内容。
+    void AppendChar(const char chr);                // 追加一个字符。
+    void AppendInt(const long value);               // 追加整数，与"%ld"相同。
+    void AppendTenths(const long value);            // 追加以0.1为单位的整数，与"%.1f"格式的value/10.0相同。
+
+    // 把写缓冲区中的内容写入文件，一般不需要调用，关闭文件时会自动调用。
+    void Flush();
+
     // 从文件中读取以换行符"\n"结束的一行，类似fgets函数。
     // buffer：用于存放读取的内容，buffer必须大于readsize+1，否则可能会造成内存的溢出。
     // readsize：本次打算读取的字节数，如果已经读取到了结束标志"\n"，函数返回。
@@ -476,7 +1110,7 @@ class CLogFile {
     bool m_bEnBuffer;  // 写入日志时，是否启用操作系统的缓冲机制，缺省不启用。
     bool m_bBackup;  // 是否自动切换，日志文件大小超过m_MaxLogSize将自动切换，缺省启用。
     long m_MaxLogSize;  // 最大日志文件的大小，单位M，缺省100M。
-    // pthread_spinlock_t spin;  // 初学暂时不要关心这行代码。
+    pthread_spinlock_t spin;  // 多线程写日志时用于加锁，保证每行日志的完整。
 
     // 构造函数。
     // MaxLogSize：最大日志文件的大小，单位M，缺省100M，最小为10M。
@@ -535,15 +1169,66 @@ class CLogFile {
 </root>
 */
 
+// 参数文件在LoadFile时只解析一次，每个标签名和它的内容存放在哈希表中，数值类型的内容预先转换好，
+// GetValue方法只查找哈希表，不再扫描参数文件的内容。获取参数的规则与GetXMLBuffer函数相同，
+// 同名的标签取第一个，标签可以嵌套，例如<root>中的每个参数都能获取到。
+// 调用EnableReload方法开启自动重新加载后，参数文件被修改或进程收到SIGHUP信号时，
+// 下一次调用GetValue方法会重新加载参数文件，服务程序不必重启。
+// 注意，CIniFile对象不能在多个线程中同时使用。
 class CIniFile {
+   private:
+    // 一个参数的内容。
+    struct st_inivalue {
+        string_view value;  // 参数的内容，指向m_content，未删除前后的空格。
+        long lvalue;        // 转换为整数的值，与atol函数相同。
+        double dvalue;      // 转换为浮点数的值，与atof函数相同。
+        bool bvalue;        // 内容是否是true，不区分大小写。
+    };
+
+    string m_filename;      // 参数文件名。
+    string m_content;       // 参数文件的内容，哈希表中的标签名和内容都指向这里。
+    unordered_map<string_view, st_inivalue> m_values;  // 全部参数的哈希表，键是标签名。
+
+    bool m_bReload;         // 是否开启了自动重新加载。
+    int m_checktvl;         // 检查参数文件修改时间的间隔，单位：秒。
+    time_t m_nextcheck;     // 下一次检查参数文件修改时间的时间。
+    time_t m_mtime;         // 已加载的参数文件的修改时间。
+    int m_sighupseq;        // 已处理的SIGHUP信号的序号。
+
+    static volatile sig_atomic_t m_sighupcount;  // 进程收到SIGHUP信号的次数。
+    static void SighupHandler(int sig);          // SIGHUP信号的处理函数。
+
+    // 解析m_content，生成参数的哈希表。
+    void Parse();
+
+    // 开启了自动重新加载时，检查是否需要重新加载参数文件。
+    void CheckReload();
+
+    // 查找参数，返回值：参数的内容，参数不存在时返回0。
+    const struct st_inivalue* Find(const char* fieldname);
+
    public:
     string m_xmlbuffer;  // 存放参数文件全部的内容，由LoadFile方法载入。
 
     CIniFile();
 
-    // 把参数文件的内容载入到m_xmlbuffer成员变量中。
+    // 哈希表中的标签名和内容指向本对象的m_content，复制后会指向原对象，所以不能复制。
+    CIniFile(const CIniFile&) = delete;
+    CIniFile& operator=(const CIniFile&) = delete;
+
+    // 把参数文件的内容载入到m_xmlbuffer成员变量中，并解析全部的参数。
     bool LoadFile(const char* filename);
 
+    // 开启自动重新加载。
+    // checktvl：检查参数文件修改时间的间隔，单位：秒，缺省5秒，GetValue方法最多每checktvl秒调用一次stat。
+    // bsighup：是否在收到SIGHUP信号时重新加载，true-安装SIGHUP信号的处理函数，缺省为true。
+    // 注意，如果程序调用了CloseIOAndSignal函数，EnableReload要在它之后调用，否则SIGHUP信号被忽略。
+    void EnableReload(const int checktvl = 5, const bool bsighup = true);
+
+    // 立即重新加载参数文件，如果加载失败，保留原来的参数。
+    // 返回值：true-成功；false-失败。
+    bool Reload();
+
     // 获取参数的值。
     // fieldname：字段的标签名。
     // value：传入变量的地址，用于存放字段的值，支持bool、int、insigned
@@ -0,0 +1,589 @@
+/**
+ * @file _surfdata.cpp
+ * @brief 此程序是开发框架全国气象站点分钟观测数据的结构体和数据文件操作类的定义文件
+ * @author Sugar (hzzou@dhu.edu.cn)
+ * @date 2022-09-10
+ */
+
+#include "_surfdata.h"
+
+// 把数据时间转换为从1970年开始的分钟数，秒被舍去。
+int SurfEpochMinute(const char *dateTime)
+{
+  time_t ltime=strtotime(dateTime);
+
+  if (ltime<0) return -1;
+
+  return ltime/60;
+}
+
+// 把st_surfdata结构体转换为紧凑格式。
+bool SurfToCompact(const struct st_surfdata *surfdata,const int stidx,struct st_surfcompact *compact)
+{
+  if ( (surfdata==0) || (compact==0) ) return false;
+
+  // 检查各要素是否超出了16位整数的取值范围。
+  if ( (surfdata->t<SHRT_MIN)  || (surfdata->t>SHRT_MAX) ) return false;
+  if ( (surfdata->p<0)  || (surfdata->p>USHRT_MAX) ) return false;
+  if ( (surfdata->u<0)  || (surfdata->u>USHRT_MAX) ) return false;
+  if ( (surfdata->wd<0) || (surfdata->wd>USHRT_MAX) ) return false;
+  if ( (surfdata->wf<0) || (surfdata->wf>USHRT_MAX) ) return false;
+  if ( (surfdata->r<0)  || (surfdata->r>USHRT_MAX) ) return false;
+
+  compact->stidx=stidx;
+  compact->vis=surfdata->vis;
+  compact->t=surfdata->t;
+  compact->p=surfdata->p;
+  compact->u=surfdata->u;
+  compact->wd=surfdata->wd;
+  compact->wf=surfdata->wf;
+  compact->r=surfdata->r;
+
+  return true;
+}
+
+// 把紧凑格式转换为st_surfdata结构体。
+void CompactToSurf(const struct st_surfcompact *compact,const char *obtid,const int epochMinute,struct st_surfdata *surfdata)
+{
+  if ( (compact==0) || (surfdata==0) ) return;
+
+  memset(surfdata,0,sizeof(struct st_surfdata));
+
+  STRNCPY(surfdata->obtid,sizeof(surfdata->obtid),obtid,10);
+  timetostr((time_t)epochMinute*60,surfdata->dateTime,"yyyymmddhh24miss");
+  surfdata->t=compact->t;
+  surfdata->p=compact->p;
+  surfdata->u=compact->u;
+  surfdata->wd=compact->wd;
+  surfdata->wf=compact->wf;
+  surfdata->r=compact->r;
+  surfdata->vis=compact->vis;
+}
+
+// 计算二进制列存数据文件的大小。
+size_t SurfBinFileSize(const int count,const int stcount)
+{
+  return sizeof(struct st_surfbinhead)+(size_t)stcount*SURFBIN_OBTIDLEN+(size_t)count*sizeof(int)*SURFBIN_COLUMNS;
+}
+
+CSurfBinFile::CSurfBinFile()
+{
+  m_fd=-1;
+  m_addr=0;
+  m_size=0;
+  m_head=0;
+  m_stcode=0;
+  m_stidx=m_t=m_p=m_u=m_wd=m_wf=m_r=m_vis=0;
+}
+
+// 打开二进制列存数据文件，并映射到内存。
+bool CSurfBinFile::Open(const char *filename)
+{
+  Close();
+
+  if ( (m_fd=open(filename,O_RDONLY)) < 0 ) return false;
+
+  struct stat st_filestat;
+
+  if ( (fstat(m_fd,&st_filestat) != 0) || (st_filestat.st_size < (off_t)sizeof(struct st_surfbinhead)) )
+  {
+    Close(); return false;
+  }
+
+  m_size=st_filestat.st_size;
+
+  if ( (m_addr=mmap(0,m_size,PROT_READ,MAP_SHARED,m_fd,0)) == MAP_FAILED )
+  {
+    m_addr=0; Close(); return false;
+  }
+
+  m_head=(const struct st_surfbinhead *)m_addr;
+
+  // 校验文件头和文件的大小，防止读取不完整的文件时越界。
+  if ( (strcmp(m_head->magic,SURFBIN_MAGIC) != 0) || (m_head->version != SURFBIN_VERSION) ||
+       (m_head->count < 0) || (m_head->stcount < 0) ||
+       (m_size != SurfBinFileSize(m_head->count,m_head->stcount)) )
+  {
+    Close(); return false;
+  }
+
+  m_stcode=(const char *)m_addr+sizeof(struct st_surfbinhead);
+
+  m_stidx=(const int *)(m_stcode+(size_t)m_head->stcount*SURFBIN_OBTIDLEN);
+  m_t  =m_stidx+m_head->count;
+  m_p  =m_t+m_head->count;
+  m_u  =m_p+m_head->count;
+  m_wd =m_u+m_head->count;
+  m_wf =m_wd+m_head->count;
+  m_r  =m_wf+m_head->count;
+  m_vis=m_r+m_head->count;
+
+  return true;
+}
+
+// 获取记录数。
+int CSurfBinFile::Count()
+{
+  if (m_head==0) return 0;
+
+  return m_head->count;
+}
+
+// 获取数据时间。
+const char *CSurfBinFile::DateTime()
+{
+  if (m_head==0) return "";
+
+  return m_head->dateTime;
+}
+
+// 获取第ii条记录的站点代码。
+const char *CSurfBinFile::Obtid(const int ii)
+{
+  if ( (m_head==0) || (ii<0) || (ii>=m_head->count) ) return "";
+
+  int stidx=m_stidx[ii];
+
+  if ( (stidx<0) || (stidx>=m_head->stcount) ) return "";
+
+  return m_stcode+(size_t)stidx*SURFBIN_OBTIDLEN;
+}
+
+// 把第ii条记录复制到surfdata结构体中。
+bool CSurfBinFile::GetValue(const int ii,struct st_surfdata *surfdata)
+{
+  if ( (m_head==0) || (surfdata==0) || (ii<0) || (ii>=m_head->count) ) return false;
+
+  memset(surfdata,0,sizeof(struct st_surfdata));
+
+  STRNCPY(surfdata->obtid,sizeof(surfdata->obtid),Obtid(ii),10);
+  STRNCPY(surfdata->dateTime,sizeof(surfdata->dateTime),m_head->dateTime,14);
+  surfdata->t=m_t[ii];
+  surfdata->p=m_p[ii];
+  surfdata->u=m_u[ii];
+  surfdata->wd=m_wd[ii];
+  surfdata->wf=m_wf[ii];
+  surfdata->r=m_r[ii];
+  surfdata->vis=m_vis[ii];
+
+  return true;
+}
+
+// 解除映射并关闭文件。
+void CSurfBinFile::Close()
+{
+  if (m_addr!=0) { munmap(m_addr,m_size); m_addr=0; }
+
+  if (m_fd!=-1) { close(m_fd); m_fd=-1; }
+
+  m_size=0;
+  m_head=0;
+  m_stcode=0;
+  m_stidx=m_t=m_p=m_u=m_wd=m_wf=m_r=m_vis=0;
+}
+
+CSurfBinFile::~CSurfBinFile()
+{
+  Close();
+}
+
+// 文本数据文件中字段的标签名，顺序与csv格式中字段的顺序相同。
+static const char *SurfFieldName[]={"obtid","ddatetime","t","p","u","wd","wf","r","vis"};
+
+#define SURFTEXT_FIELDS 9                           // 字段的个数。
+#define SURFTEXT_ALLFIELDS ((1<<SURFTEXT_FIELDS)-1)  // 全部字段都解析成功时的标志位。
+
+// 根据标签名查找字段的序号，返回-1表示不是观测数据的字段。
+static int SurfFieldIndex(const char *name,const size_t namelen)
+{
+  for (int ii=0;ii<SURFTEXT_FIELDS;ii++)
+  {
+    if ( (strncmp(SurfFieldName[ii],name,namelen)==0) && (SurfFieldName[ii][namelen]==0) ) return ii;
+  }
+
+  return -1;
+}
+
+// 从[beg,end)中解析数值，可以带符号，不经过浮点数转换，不会有精度误差。
+// btenths：true-转换为以0.1为单位的整数，例如"-7.5"转换为-75，第二位及以后的小数被忽略；
+//          false-转换为整数，小数部分被忽略，例如"35"转换为35。
+static bool SurfNumber(const char *beg,const char *end,const bool btenths,int *value)
+{
+  bool bneg=false;
+
+  if ( (beg<end) && ( (*beg=='-') || (*beg=='+') ) ) { bneg=(*beg=='-'); beg++; }
+
+  if ( (beg==end) || (*beg<'0') || (*beg>'9') ) return false;
+
+  long ivalue=0;
+
+  for (;(beg<end) && (*beg>='0') && (*beg<='9');beg++) ivalue=ivalue*10+(*beg-'0');
+
+  int tenth=0;
+
+  if ( (beg<end) && (*beg=='.') )
+  {
+    beg++;
+    if ( (beg<end) && (*beg>='0') && (*beg<='9') ) tenth=*beg-'0';
+    for (;(beg<end) && (*beg>='0') && (*beg<='9');beg++);
+  }
+
+  if (beg!=end) return false;     // 数值后面还有其它字符。
+
+  if (btenths==true) ivalue=ivalue*10+tenth;
+
+  if (ivalue>INT_MAX) return false;
+
+  (*value)=(bneg==true)?-ivalue:ivalue;
+
+  return true;
+}
+
+// 把[beg,end)中的字段内容存放到surfdata中，ii是字段的序号。
+static bool SurfFieldValue(const int ii,const char *beg,const char *end,struct st_surfdata *surfdata)
+{
+  switch (ii)
+  {
+    case 0:
+      if ( (end-beg) > 10 ) return false;
+      memcpy(surfdata->obtid,beg,end-beg); surfdata->obtid[end-beg]=0;
+      return true;
+    case 1:
+      if ( (end-beg) > 20 ) return false;
+      memcpy(surfdata->dateTime,beg,end-beg); surfdata->dateTime[end-beg]=0;
+      return true;
+    case 2: return SurfNumber(beg,end,true,&surfdata->t);
+    case 3: return SurfNumber(beg,end,true,&surfdata->p);
+    case 4: return SurfNumber(beg,end,false,&surfdata->u);
+    case 5: return SurfNumber(beg,end,false,&surfdata->wd);
+    case 6: return SurfNumber(beg,end,true,&surfdata->wf);
+    case 7: return SurfNumber(beg,end,true,&surfdata->r);
+    case 8: return SurfNumber(beg,end,true,&surfdata->vis);
+  }
+
+  return false;
+}
+
+CSurfTextFile::CSurfTextFile()
+{
+  m_fd=-1;
+  m_addr=0;
+  m_size=0;
+  m_pos=m_end=0;
+  m_released=0;
+  m_format=SURFTEXT_UNKNOWN;
+  m_count=m_errcount=0;
+}
+
+// 打开数据文件，并映射到内存，识别文件的格式。
+bool CSurfTextFile::Open(const char *filename)
+{
+  Close();
+
+  if ( (m_fd=open(filename,O_RDONLY)) < 0 ) return false;
+
+  struct stat st_filestat;
+
+  if ( (fstat(m_fd,&st_filestat) != 0) || (st_filestat.st_size == 0) )
+  {
+    Close(); return false;
+  }
+
+  m_size=st_filestat.st_size;
+
+  if ( (m_addr=(char *)mmap(0,m_size,PROT_READ,MAP_SHARED,m_fd,0)) == MAP_FAILED )
+  {
+    m_addr=0; Close(); return false;
+  }
+
+  // 文件是顺序读取的，让内核提前预读。
+  madvise(m_addr,m_size,MADV_SEQUENTIAL);
+
+  m_end=m_addr+m_size;
+
+  // 跳过文件开始的空白字符，根据第一个字符识别格式。
+  const char *pos=m_addr;
+
+  while ( (pos<m_end) && (isspace((unsigned char)*pos)) ) pos++;
+
+  if (pos==m_end) { Close(); return false; }
+
+  if (*pos=='<')
+  {
+    // xml格式，<data>标签在解析第一条记录时被忽略。
+    m_format=SURFTEXT_XML; m_pos=pos;
+  }
+  else if (*pos=='{')
+  {
+    // json格式，记录从data数组开始。
+    if ( (pos=(const char *)memchr(pos,'[',m_end-pos)) == 0 ) { Close(); return false; }
+
+    m_format=SURFTEXT_JSON; m_pos=pos+1;
+  }
+  else if ( ((unsigned char)pos[0]==0x1f) && (pos+1<m_end) && ((unsigned char)pos[1]==0x8b) )
+  {
+    // gzip压缩的文件。
+    Close(); return false;
+  }
+  else
+  {
+    // csv格式，第一行没有数字就是文件头，跳过。
+    m_format=SURFTEXT_CSV; m_pos=pos;
+
+    const char *lineend=(const char *)memchr(pos,'\n',m_end-pos);
+
+    if (lineend==0) lineend=m_end;
+
+    const char *ch=pos;
+
+    for (;(ch<lineend) && ( (*ch<'0') || (*ch>'9') );ch++);
+
+    if (ch==lineend) m_pos=lineend;
+  }
+
+  return true;
+}
+
+// 获取文件的格式。
+int CSurfTextFile::Format()
+{
+  return m_format;
+}
+
+// 查找下一条记录。
+bool CSurfTextFile::NextRecord(const char *&beg,const char *&end)
+{
+  if ( (m_addr==0) || (m_pos>=m_end) ) return false;
+
+  if (m_format==SURFTEXT_XML)
+  {
+    // 每条记录以<endl/>结束。
+    if ( (end=(const char *)memmem(m_pos,m_end-m_pos,"<endl/>",7)) == 0 ) { m_pos=m_end; return false; }
+
+    beg=m_pos; m_pos=end+7;
+
+    return true;
+  }
+
+  if (m_format==SURFTEXT_JSON)
+  {
+    // 每条记录是一个{}对象，字段的内容中没有花括号。
+    if ( (beg=(const char *)memchr(m_pos,'{',m_end-m_pos)) == 0 ) { m_pos=m_end; return false; }
+
+    if ( (end=(const char *)memchr(beg,'}',m_end-beg)) == 0 ) { m_pos=m_end; return false; }
+
+    beg++; m_pos=end+1;
+
+    return true;
+  }
+
+  // csv格式，每行一条记录，跳过空行。
+  while ( (m_pos<m_end) && ( (*m_pos=='\n') || (*m_pos=='\r') ) ) m_pos++;
+
+  if (m_pos==m_end) return false;
+
+  beg=m_pos;
+
+  if ( (end=(const char *)memchr(m_pos,'\n',m_end-m_pos)) == 0 ) end=m_end;
+
+  m_pos=(end==m_end)?m_end:end+1;
+
+  if (*(end-1)=='\r') end--;
+
+  return true;
+}
+
+// 解析一条csv格式的记录，字段的顺序与SurfFieldName相同。
+bool CSurfTextFile::ParseCSV(const char *beg,const char *end,struct st_surfdata *surfdata)
+{
+  for (int ii=0;ii<SURFTEXT_FIELDS;ii++)
+  {
+    const char *sep=(const char *)memchr(beg,',',end-beg);
+
+    // 最后一个字段后面不能再有逗号，其它字段后面必须有逗号。
+    if ( (sep==0) != (ii==SURFTEXT_FIELDS-1) ) return false;
+
+    if (sep==0) sep=end;
+
+    if (SurfFieldValue(ii,beg,sep,surfdata)==false) return false;
+
+    beg=sep+1;
+  }
+
+  return true;
+}
+
+// 解析一条xml格式的记录，由<name>value</name>组成，不是观测数据的标签被忽略。
+bool CSurfTextFile::ParseXML(const char *beg,const char *end,struct st_surfdata *surfdata)
+{
+  int mask=0;
+  const char *pos=beg;
+
+  while ( (pos=(const char *)memchr(pos,'<',end-pos)) != 0 )
+  {
+    const char *name=pos+1;
+    const char *nameend=(const char *)memchr(name,'>',end-name);
+
+    if (nameend==0) break;
+
+    const char *valbeg=nameend+1;
+    const char *valend=(const char *)memchr(valbeg,'<',end-valbeg);
+
+    if (valend==0) break;
+
+    size_t namelen=nameend-name;
+
+    // 内容之后必须是</name>，否则不是字段，例如<data>，从下一个标签继续。
+    if ( (*name=='/') || ((size_t)(end-valend) < namelen+3) || (valend[1]!='/') ||
+         (memcmp(valend+2,name,namelen)!=0) || (valend[namelen+2]!='>') )
+    {
+      pos=valend; continue;
+    }
+
+    int ii=SurfFieldIndex(name,namelen);
+
+    if (ii>=0)
+    {
+      if (SurfFieldValue(ii,valbeg,valend,surfdata)==false) return false;
+
+      mask=mask|(1<<ii);
+    }
+
+    pos=valend+namelen+3;
+  }
+
+  return mask==SURFTEXT_ALLFIELDS;
+}
+
+// 解析一条json格式的记录，由"name":"value"组成，不是观测数据的字段被忽略。
+bool CSurfTextFile::ParseJSON(const char *beg,const char *end,struct st_surfdata *surfdata)
+{
+  int mask=0;
+  const char *pos=beg;
+
+  while ( (pos=(const char *)memchr(pos,'"',end-pos)) != 0 )
+  {
+    const char *name=pos+1;
+    const char *nameend=(const char *)memchr(name,'"',end-name);
+
+    if (nameend==0) return false;
+
+    // 字段名之后是冒号，前后可以有空格。
+    const char *valbeg=nameend+1;
+
+    while ( (valbeg<end) && (*valbeg==' ') ) valbeg++;
+
+    if ( (valbeg==end) || (*valbeg!=':') ) return false;
+
+    valbeg++;
+
+    while ( (valbeg<end) && (*valbeg==' ') ) valbeg++;
+
+    const char *valend=0;
+
+    if ( (valbeg<end) && (*valbeg=='"') )
+    {
+      // 字符串，到下一个双引号为止。
+      valbeg++;
+
+      if ( (valend=(const char *)memchr(valbeg,'"',end-valbeg)) == 0 ) return false;
+
+      pos=valend+1;
+    }
+    else
+    {
+      // 数值，到逗号或记录结束为止。
+      if ( (valend=(const char *)memchr(valbeg,',',end-valbeg)) == 0 ) valend=end;
+
+      pos=valend;
+
+      while ( (valend>valbeg) && (isspace((unsigned char)*(valend-1))) ) valend--;
+    }
+
+    int ii=SurfFieldIndex(name,nameend-name);
+
+    if (ii>=0)
+    {
+      if (SurfFieldValue(ii,valbeg,valend,surfdata)==false) return false;
+
+      mask=mask|(1<<ii);
+    }
+  }
+
+  return mask==SURFTEXT_ALLFIELDS;
+}
+
+// 解析下一批记录。
+int CSurfTextFile::Next(struct st_surfdata *surfdata,const int maxcount)
+{
+  if ( (m_addr==0) || (surfdata==0) ) return 0;
+
+  int count=0;
+  const char *beg=0,*end=0;
+
+  while ( (count<maxcount) && (NextRecord(beg,end)==true) )
+  {
+    memset(&surfdata[count],0,sizeof(struct st_surfdata));
+
+    bool bret=false;
+
+    if (m_format==SURFTEXT_XML)  bret=ParseXML(beg,end,&surfdata[count]);
+    if (m_format==SURFTEXT_JSON) bret=ParseJSON(beg,end,&surfdata[count]);
+    if (m_format==SURFTEXT_CSV)  bret=ParseCSV(beg,end,&surfdata[count]);
+
+    if (bret==true) count++;
+    else m_errcount++;
+  }
+
+  m_count=m_count+count;
+
+  Release();
+
+  return count;
+}
+
+// 释放m_pos之前已经解析过的内存，只释放完整的页，每次至少释放1M，减少系统调用的次数。
+// 映射的是只读文件，释放后的页如果再访问，内核会从文件中重新读取。
+void CSurfTextFile::Release()
+{
+  static const size_t pagesize=sysconf(_SC_PAGESIZE);
+
+  size_t consumed=(m_pos-m_addr)/pagesize*pagesize;
+
+  if (consumed < m_released+1024*1024) return;
+
+  madvise(m_addr+m_released,consumed-m_released,MADV_DONTNEED);
+
+  m_released=consumed;
+}
+
+// 获取已解析的记录数。
+long CSurfTextFile::Count()
+{
+  return m_count;
+}
+
+// 获取格式不正确被跳过的记录数。
+long CSurfTextFile::ErrCount()
+{
+  return m_errcount;
+}
+
+// 解除映射并关闭文件。
+void CSurfTextFile::Close()
+{
+  if (m_addr!=0) { munmap(m_addr,m_size); m_addr=0; }
+
+  if (m_fd!=-1) { close(m_fd); m_fd=-1; }
+
+  m_size=0;
+  m_pos=m_end=0;
+  m_released=0;
+  m_format=SURFTEXT_UNKNOWN;
+  m_count=m_errcount=0;
+}
+
+CSurfTextFile::~CSurfTextFile()
+{
+  Close();
+}
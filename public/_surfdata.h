@@ -0,0 +1,204 @@
+/**
+ * @file _surfdata.h
+ * @brief 此程序是开发框架全国气象站点分钟观测数据的结构体和数据文件操作类的声明文件
+ * @author Sugar (hzzou@dhu.edu.cn)
+ * @date 2022-09-10
+ */
+
+#ifndef __SURFDATA_H
+#define __SURFDATA_H
+
+#include "_public.h"
+
+// 全国气象站点分钟观测数据结构
+struct st_surfdata {
+    char obtid[11];     // 站点代码
+    char dateTime[21];  // 数据时间，格式-yyyymmddhh24miss
+    int t;              // 气温：单位0.1摄氏度
+    int p;              // 气压：单位0.1百帕
+    int u;              // 相对湿度：0-100之间的值，本质就是百分比
+    int wd;             // 风向：0-360之间的值，单位度
+    int wf;             // 风速：单位0.1m/s
+    int r;              // 降雨量：单位0.1mm
+    int vis;            // 能见度：单位0.1m
+};
+
+///////////////////////////////////// /////////////////////////////////////
+// 紧凑格式的分钟观测数据，用于在内存中存放大量站点的观测数据
+// 1）站点代码换成站点参数表的下标，数据时间换成从1970年开始的分钟数，由同一时间点的全部记录共用，不存放在记录中；
+// 2）取值范围允许的要素用16位整数存放，能见度超过了16位整数的范围，仍用32位整数；
+// 3）每条记录20字节，st_surfdata是60字节。
+
+// 紧凑格式的分钟观测数据结构
+struct st_surfcompact {
+    int stidx;              // 站点序号，站点参数表的下标
+    int vis;                // 能见度：单位0.1m
+    short t;                // 气温：单位0.1摄氏度，-3276.8至3276.7
+    unsigned short p;       // 气压：单位0.1百帕，0至6553.5
+    unsigned short u;       // 相对湿度：0-100之间的值
+    unsigned short wd;      // 风向：0-360之间的值，单位度
+    unsigned short wf;      // 风速：单位0.1m/s，0至6553.5
+    unsigned short r;       // 降雨量：单位0.1mm，0至6553.5
+};
+
+// 把数据时间转换为从1970年开始的分钟数，秒被舍去。
+// dateTime：数据时间，格式-yyyymmddhh24miss。
+// 返回值：分钟数，dateTime的格式不正确时返回-1。
+int SurfEpochMinute(const char* dateTime);
+
+// 把st_surfdata结构体转换为紧凑格式，数据时间不转换，由调用者用SurfEpochMinute函数另外存放。
+// stidx：站点序号，由调用者根据obtid在站点参数表中查找。
+// 返回值：true-成功；false-有要素超出了紧凑格式的取值范围，compact的内容不确定。
+bool SurfToCompact(const struct st_surfdata* surfdata, const int stidx, struct st_surfcompact* compact);
+
+// 把紧凑格式转换为st_surfdata结构体。
+// obtid：站点代码，由调用者根据compact->stidx在站点参数表中查找。
+// epochMinute：数据时间，从1970年开始的分钟数。
+void CompactToSurf(const struct st_surfcompact* compact, const char* obtid, const int epochMinute, struct st_surfdata* surfdata);
+
+///////////////////////////////////// /////////////////////////////////////
+// 二进制列存格式的分钟观测数据文件（.bin）
+// 文件的布局如下，全部是定长字段，采用本机字节序：
+// 1）文件头st_surfbinhead，64字节；
+// 2）站点代码表，m_stcount个SURFBIN_OBTIDLEN字节的站点代码；
+// 3）站点序号列，m_count个int，是站点代码表的下标；
+// 4）t、p、u、wd、wf、r、vis七列，每列m_count个int，单位与st_surfdata相同。
+// 全部记录的数据时间相同，只在文件头中存放一次。
+
+#define SURFBIN_MAGIC "SURFBIN"    // 文件头的标志。
+#define SURFBIN_VERSION 1          // 文件格式的版本。
+#define SURFBIN_OBTIDLEN 12        // 站点代码表中每个站点代码占用的字节数。
+#define SURFBIN_COLUMNS 8          // 列的数量，站点序号列加七个观测要素列。
+
+// 二进制列存数据文件的文件头。
+struct st_surfbinhead {
+    char magic[8];       // 文件头的标志，固定填SURFBIN_MAGIC。
+    int version;         // 文件格式的版本，固定填SURFBIN_VERSION。
+    int count;           // 记录数。
+    int stcount;         // 站点代码表中站点的数量。
+    char dateTime[16];   // 数据时间，格式-yyyymmddhh24miss。
+    char reserve[28];    // 保留，填0。
+};
+
+// 计算二进制列存数据文件的大小。
+// count：记录数。
+// stcount：站点代码表中站点的数量。
+size_t SurfBinFileSize(const int count, const int stcount);
+
+// 二进制列存数据文件的读取类，用mmap映射文件，各列直接指向映射的内存，不复制数据。
+class CSurfBinFile {
+   private:
+    int m_fd;         // 文件描述符。
+    void* m_addr;     // 文件映射的地址。
+    size_t m_size;    // 文件的大小，单位：字节。
+
+   public:
+    const struct st_surfbinhead* m_head;  // 文件头。
+    const char* m_stcode;  // 站点代码表，每个站点代码占SURFBIN_OBTIDLEN字节。
+    const int* m_stidx;    // 站点序号列。
+    const int* m_t;        // 气温列。
+    const int* m_p;        // 气压列。
+    const int* m_u;        // 相对湿度列。
+    const int* m_wd;       // 风向列。
+    const int* m_wf;       // 风速列。
+    const int* m_r;        // 降雨量列。
+    const int* m_vis;      // 能见度列。
+
+    CSurfBinFile();  // 构造函数。
+
+    // 打开二进制列存数据文件，并映射到内存。
+    // 返回值：true-成功；false-失败，失败的原因可能是文件不存在、不是二进制列存数据文件或文件不完整。
+    bool Open(const char* filename);
+
+    // 获取记录数。
+    int Count();
+
+    // 获取数据时间，格式-yyyymmddhh24miss。
+    const char* DateTime();
+
+    // 获取第ii条记录的站点代码。
+    const char* Obtid(const int ii);
+
+    // 把第ii条记录复制到surfdata结构体中。
+    // 返回值：true-成功；false-ii超出了记录数的范围。
+    bool GetValue(const int ii, struct st_surfdata* surfdata);
+
+    // 解除映射并关闭文件。
+    void Close();
+
+    ~CSurfBinFile();  // 析构函数会调用Close方法。
+};
+///////////////////////////////////// /////////////////////////////////////
+
+///////////////////////////////////// /////////////////////////////////////
+// 文本格式（xml、json和csv）的分钟观测数据文件的读取类，文件的格式与crtsurfdata程序生成的相同。
+// 1）用mmap映射文件，直接在映射的内存中查找记录和解析字段，不逐行复制到缓冲区；
+// 2）打开文件时根据文件的内容自动识别格式，csv格式的文件头（第一行）被跳过；
+// 3）每次调用Next方法解析一批记录，已经解析过的内存用madvise释放，读取很大的文件时，占用的内存也不会增加；
+// 4）不支持gzip压缩的数据文件。
+// 用法示例：
+//   CSurfTextFile File;
+//   struct st_surfdata surfdata[1000];
+//   if (File.Open("/tmp/SURF_ZH_20220901120000_1234.xml")==false) return;
+//   int count;
+//   while ( (count=File.Next(surfdata,1000)) > 0 ) { ... }
+
+#define SURFTEXT_UNKNOWN 0   // 不能识别的格式。
+#define SURFTEXT_XML 1       // xml格式，每条记录以<endl/>结束。
+#define SURFTEXT_JSON 2      // json格式，记录是data数组中的对象。
+#define SURFTEXT_CSV 3       // csv格式，每行一条记录。
+
+class CSurfTextFile {
+   private:
+    int m_fd;              // 文件描述符。
+    char* m_addr;          // 文件映射的地址。
+    size_t m_size;         // 文件的大小，单位：字节。
+    const char* m_pos;     // 下一条记录开始查找的位置。
+    const char* m_end;     // 文件内容的结束位置。
+    size_t m_released;     // 已经用madvise释放的字节数，从文件开始计算，是页大小的整数倍。
+    int m_format;          // 文件的格式，取值为SURFTEXT_XML、SURFTEXT_JSON或SURFTEXT_CSV。
+    long m_count;          // 已解析的记录数。
+    long m_errcount;       // 格式不正确被跳过的记录数。
+
+    // 查找下一条记录，beg和end是记录的起止位置，end不包括记录的结束标志。
+    // 返回值：true-找到了记录；false-已到文件结尾。
+    bool NextRecord(const char*& beg, const char*& end);
+
+    // 解析一条记录，返回值：true-成功；false-记录的格式不正确。
+    bool ParseCSV(const char* beg, const char* end, struct st_surfdata* surfdata);
+    bool ParseXML(const char* beg, const char* end, struct st_surfdata* surfdata);
+    bool ParseJSON(const char* beg, const char* end, struct st_surfdata* surfdata);
+
+    // 释放m_pos之前已经解析过的内存。
+    void Release();
+
+   public:
+    CSurfTextFile();  // 构造函数。
+
+    // 打开数据文件，并映射到内存，识别文件的格式。
+    // 返回值：true-成功；false-失败，失败的原因可能是文件不存在、文件为空或不能识别文件的格式。
+    bool Open(const char* filename);
+
+    // 获取文件的格式，返回SURFTEXT_XML、SURFTEXT_JSON、SURFTEXT_CSV或SURFTEXT_UNKNOWN（未打开文件）。
+    int Format();
+
+    // 解析下一批记录。
+    // surfdata：存放记录的数组，由调用者分配。
+    // maxcount：surfdata数组的大小，每批最多解析的记录数。
+    // 返回值：本批解析的记录数，0表示已到文件结尾，格式不正确的记录被跳过，不计入返回值。
+    int Next(struct st_surfdata* surfdata, const int maxcount);
+
+    // 获取已解析的记录数。
+    long Count();
+
+    // 获取格式不正确被跳过的记录数。
+    long ErrCount();
+
+    // 解除映射并关闭文件。
+    void Close();
+
+    ~CSurfTextFile();  // 析构函数会调用Close方法。
+};
+///////////////////////////////////// /////////////////////////////////////
+
+#endif
@@ -0,0 +1,379 @@
+/**
+ * @file benchpublic.cpp
+ * @brief 开发框架公用函数的性能测试程序，输出每个函数每次调用的耗时（纳秒）和内存分配次数，用于对比修改前后的性能
+ * @author Sugar (hzzou@dhu.edu.cn)
+ * @date 2022-09-20
+ */
+
+#include "../_public.h"
+
+// 统计内存分配的次数，替换malloc、calloc和realloc，new也是调用malloc分配内存的
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t nmemb, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+long benchAllocs = 0;   // 内存分配的次数
+
+extern "C" void* malloc(size_t size) {
+    benchAllocs++;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t nmemb, size_t size) {
+    benchAllocs++;
+    return __libc_calloc(nmemb, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    benchAllocs++;
+    return __libc_realloc(ptr, size);
+}
+
+// 防止测试的代码被编译器优化掉
+volatile long benchSink = 0;
+
+// 一个测试项目，func执行n次被测试的函数
+struct st_bench {
+    const char* name;       // 测试项目的名称
+    void (*func)(long n);   // 测试函数
+};
+
+const char* SURFLINE = "安徽,58015,砀山,34.27,116.2,44.2";
+const char* SURFXML = "<obtid>58015</obtid><ddatetime>20220901120000</ddatetime><t>28.5</t><p>1002.3</p>"
+                      "<u>65</u><wd>180</wd><wf>3.5</wf><r>0.0</r><vis>10500.0</vis><endl/>";
+
+void benchSTRCPY(long n) {
+    char dest[301];
+    for (long i = 0; i < n; ++i) {
+        STRCPY(dest, sizeof(dest), SURFLINE);
+        benchSink += dest[0];
+    }
+}
+
+void benchSNPRINTF(long n) {
+    char dest[301];
+    for (long i = 0; i < n; ++i) {
+        SNPRINTF(dest, sizeof(dest), 300, "%s,%s,%.1f,%d", "58015", "20220901120000", 28.5, (int)i);
+        benchSink += dest[0];
+    }
+}
+
+void benchMatchStr(long n) {
+    for (long i = 0; i < n; ++i) {
+        benchSink += MatchStr("SURF_ZH_20220901120000_1234.csv", "*.xml,*.json,*.csv");
+    }
+}
+
+void benchCMatchRule(long n) {
+    CMatchRule MatchRule("*.xml,*.json,*.csv");
+    for (long i = 0; i < n; ++i) {
+        benchSink += MatchRule.Match("SURF_ZH_20220901120000_1234.csv");
+    }
+}
+
+void benchSplitToCmd(long n) {
+    CCmdStr CmdStr;
+    double lat;
+    for (long i = 0; i < n; ++i) {
+        CmdStr.SplitToCmd(SURFLINE, ",", true);
+        CmdStr.GetValue(3, &lat);
+        benchSink += CmdStr.CmdCount();
+    }
+}
+
+void benchSplitToView(long n) {
+    CCmdStr CmdStr;
+    double lat;
+    for (long i = 0; i < n; ++i) {
+        CmdStr.SplitToView(SURFLINE, ",", true);
+        CmdStr.GetValue(3, &lat);
+        benchSink += CmdStr.CmdCount();
+    }
+}
+
+// 从一条xml格式的观测数据中获取全部九个字段
+void benchGetXMLBuffer(long n) {
+    char obtid[11], ddatetime[21];
+    double t, p, wf, r, vis;
+    int u, wd;
+    for (long i = 0; i < n; ++i) {
+        GetXMLBuffer(SURFXML, "obtid", obtid, 10);
+        GetXMLBuffer(SURFXML, "ddatetime", ddatetime, 14);
+        GetXMLBuffer(SURFXML, "t", &t);
+        GetXMLBuffer(SURFXML, "p", &p);
+        GetXMLBuffer(SURFXML, "u", &u);
+        GetXMLBuffer(SURFXML, "wd", &wd);
+        GetXMLBuffer(SURFXML, "wf", &wf);
+        GetXMLBuffer(SURFXML, "r", &r);
+        GetXMLBuffer(SURFXML, "vis", &vis);
+        benchSink += u;
+    }
+}
+
+void benchCXMLRecord(long n) {
+    CXMLRecord XMLRecord;
+    char obtid[11], ddatetime[21];
+    double t, p, wf, r, vis;
+    int u, wd;
+    for (long i = 0; i < n; ++i) {
+        XMLRecord.Parse(SURFXML);
+        XMLRecord.GetValue("obtid", obtid, 10);
+        XMLRecord.GetValue("ddatetime", ddatetime, 14);
+        XMLRecord.GetValue("t", &t);
+        XMLRecord.GetValue("p", &p);
+        XMLRecord.GetValue("u", &u);
+        XMLRecord.GetValue("wd", &wd);
+        XMLRecord.GetValue("wf", &wf);
+        XMLRecord.GetValue("r", &r);
+        XMLRecord.GetValue("vis", &vis);
+        benchSink += u;
+    }
+}
+
+// 生成一条xml格式的观测数据，与SURFXML的内容相同
+void benchCStrBuilder(long n) {
+    CStrBuilder StrBuilder(STRB_XML);
+    for (long i = 0; i < n; ++i) {
+        StrBuilder.Clear();
+        StrBuilder.BeginRecord();
+        StrBuilder.AddField("obtid", "58015");
+        StrBuilder.AddField("ddatetime", "20220901120000");
+        StrBuilder.AddTenths("t", 285);
+        StrBuilder.AddTenths("p", 10023);
+        StrBuilder.AddField("u", 65);
+        StrBuilder.AddField("wd", 180);
+        StrBuilder.AddTenths("wf", 35);
+        StrBuilder.AddTenths("r", 0);
+        StrBuilder.AddTenths("vis", 105000);
+        StrBuilder.EndRecord();
+        benchSink += StrBuilder.Length();
+    }
+}
+
+void benchLocalTime(long n) {
+    char stime[21];
+    for (long i = 0; i < n; ++i) {
+        LocalTime(stime, "yyyymmddhh24miss");
+        benchSink += stime[13];
+    }
+}
+
+// 每次转换的时间都不同，与扫描目录时转换文件的时间相同，不能使用同一秒的缓存
+void benchtimetostr(long n) {
+    char stime[21];
+    for (long i = 0; i < n; ++i) {
+        timetostr(1661999400 + i % 86400, stime, "yyyy-mm-dd hh24:mi:ss");
+        benchSink += stime[18];
+    }
+}
+
+void benchstrtotime(long n) {
+    const char* stimes[8] = {"20220901000000", "20220901010000", "20220901020000", "20220901030000",
+                             "20220901040000", "20220901050000", "20220901060000", "20220901070000"};
+    for (long i = 0; i < n; ++i) {
+        benchSink += strtotime(stimes[i % 8]);
+    }
+}
+
+// 一次转换一个数据文件中的一批观测时间，同一天的不同时刻，与逐个调用strtotime对比
+void benchstrtotimeBatch(long n) {
+    const char* stimes[8] = {"20220901000000", "20220901010000", "20220901020000", "20220901030000",
+                             "20220901040000", "20220901050000", "20220901060000", "20220901070000"};
+    time_t ltimes[8];
+    for (long i = 0; i < n; i += 8) {
+        benchSink += strtotime(stimes, ltimes, 8);
+    }
+}
+
+// 从参数文件中获取一个字符串参数和一个整数参数
+void benchCIniFile(long n) {
+    const char* filename = "/tmp/benchpublic_ini.xml";
+    CFile File;
+    File.Open(filename, "w");
+    File.Fprintf("<?xml version=\"1.0\" encoding=\"utf-8\" ?>\n<root>\n");
+    for (int i = 0; i < 30; ++i) File.Fprintf("    <!-- 参数%d。 -->\n    <param%d>value%d</param%d>\n", i, i, i, i);
+    File.Fprintf("    <serverip>192.168.1.1</serverip>\n    <port>5058</port>\n</root>\n");
+    File.Close();
+
+    CIniFile IniFile;
+    IniFile.LoadFile(filename);
+
+    char serverip[51];
+    int port;
+    for (long i = 0; i < n; ++i) {
+        IniFile.GetValue("serverip", serverip, 50);
+        IniFile.GetValue("port", &port);
+        benchSink += port;
+    }
+}
+
+// 每次读取一行，读到文件结尾后重新打开
+void benchFgets(long n) {
+    const char* filename = "/tmp/benchpublic_fgets.txt";
+    CFile File;
+    char buffer[301];
+
+    if (!File.Open(filename, "r")) {
+        // 测试文件不存在就先生成，10万行站点参数
+        File.Open(filename, "w");
+        for (int i = 0; i < 100000; ++i) File.Fprintf("%s\n", SURFLINE);
+        File.Close();
+        File.Open(filename, "r");
+    }
+
+    for (long i = 0; i < n; ++i) {
+        if (!File.Fgets(buffer, 300, true)) {
+            File.Close();
+            File.Open(filename, "r");
+            File.Fgets(buffer, 300, true);
+        }
+        benchSink += buffer[0];
+    }
+}
+
+// 每次获取目录中的一个文件，扫描完后重新打开，目录中有1万个文件，一半能匹配
+void benchCDirScanner(long n) {
+    const char* dirname = "/tmp/benchpublic_dir";
+    if (access(dirname, F_OK) != 0) {
+        CFile File;
+        char filename[301];
+        for (int i = 0; i < 10000; ++i) {
+            SNPRINTF(filename, sizeof(filename), 300, "%s/SURF_ZH_%05d.%s", dirname, i, i % 2 ? "xml" : "tmp");
+            File.Open(filename, "w");
+            File.Close();
+        }
+    }
+
+    CDirScanner Dir;
+    CMatchRule MatchRule("*.xml");
+    Dir.OpenDir(dirname, MatchRule);
+    for (long i = 0; i < n; ++i) {
+        if (!Dir.ReadDir()) {
+            Dir.OpenDir(dirname, MatchRule);
+            Dir.ReadDir();
+        }
+        benchSink += Dir.m_FileSize;
+    }
+}
+
+// 与benchCDirScanner相同的目录，目录没有变化，重新打开时直接使用快照，不读取目录项
+void benchCDirSnapshot(long n) {
+    const char* dirname = "/tmp/benchpublic_dir";
+    const char* snapfile = "/tmp/benchpublic_dir.snap";
+    benchCDirScanner(1);  // 创建目录和文件
+
+    CDirSnapshot Dir;
+    Dir.OpenDir(dirname, "*.xml", snapfile);
+    Dir.SaveSnapshot();
+    for (long i = 0; i < n; ++i) {
+        if (!Dir.ReadDir()) {
+            Dir.OpenDir(dirname, "*.xml", snapfile);
+            Dir.ReadDir();
+        }
+        benchSink += Dir.m_FileSize;
+    }
+}
+
+// 通过socketpair一发一收，报文长度与一条xml格式的观测数据相同
+void benchTcpReadWrite(long n) {
+    int sockfd[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockfd) != 0) return;
+
+    char buffer[1024];
+    int ibuflen = 0;
+    for (long i = 0; i < n; ++i) {
+        TcpWrite(sockfd[0], SURFXML);
+        TcpRead(sockfd[1], buffer, &ibuflen);
+        benchSink += ibuflen;
+    }
+
+    close(sockfd[0]);
+    close(sockfd[1]);
+}
+
+// 开始统计耗时后，一个空代码块的耗时，即PROFILE宏本身的开销
+void benchPROFILE(long n) {
+    CProfiler::Enable();
+    for (long i = 0; i < n; ++i) {
+        PROFILE("benchPROFILE");
+        benchSink += i;
+    }
+    CProfiler::Disable();
+}
+
+struct st_bench benchs[] = {
+    {"STRCPY", benchSTRCPY},
+    {"SNPRINTF", benchSNPRINTF},
+    {"MatchStr", benchMatchStr},
+    {"CMatchRule::Match", benchCMatchRule},
+    {"CCmdStr::SplitToCmd", benchSplitToCmd},
+    {"CCmdStr::SplitToView", benchSplitToView},
+    {"GetXMLBuffer", benchGetXMLBuffer},
+    {"CXMLRecord", benchCXMLRecord},
+    {"CStrBuilder", benchCStrBuilder},
+    {"LocalTime", benchLocalTime},
+    {"timetostr", benchtimetostr},
+    {"strtotime", benchstrtotime},
+    {"strtotime(batch)", benchstrtotimeBatch},
+    {"CIniFile::GetValue", benchCIniFile},
+    {"CFile::Fgets", benchFgets},
+    {"CDirScanner::ReadDir", benchCDirScanner},
+    {"CDirSnapshot::ReadDir", benchCDirSnapshot},
+    {"TcpRead/TcpWrite", benchTcpReadWrite},
+    {"PROFILE", benchPROFILE},
+};
+
+// 获取单调时钟的时间，单位：纳秒
+long nowNS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 2) {
+        printf("Using: ./benchpublic [matchstr]\n");
+        printf("Example: ./benchpublic\n");
+        printf("         ./benchpublic \"*Match*,strtotime\"\n\n");
+        printf("matchstr 只运行名称能匹配上的测试项目，规则与MatchStr函数相同，缺省运行全部的测试项目。\n");
+        printf("输出的每一行是一个测试项目，字段之间用制表符分隔：名称、每轮执行的次数、每次的耗时（纳秒）、每次分配内存的次数。\n");
+        printf("每个项目先确定每轮执行的次数，使一轮的耗时不少于0.2秒，再执行5轮取最快的一轮，结果可以保存下来与其它版本对比。\n\n");
+        return -1;
+    }
+
+    const int ROUNDS = 5;           // 每个项目执行的轮数
+    const long MINNS = 200000000;   // 每轮的最短耗时，单位：纳秒
+
+    printf("# name\titerations\tns/op\tallocs/op\n");
+
+    for (auto& bench : benchs) {
+        if (argc == 2 && !MatchStr(bench.name, argv[1])) continue;
+
+        // 预热一次，再把执行次数加倍，直到一轮的耗时不少于MINNS
+        bench.func(1);
+        long n = 1;
+        while (true) {
+            long begin = nowNS();
+            bench.func(n);
+            if (nowNS() - begin >= MINNS) break;
+            n = n * 2;
+        }
+
+        // 执行ROUNDS轮，取最快的一轮，内存分配的次数与轮次无关
+        double bestNS = 0;
+        double allocs = 0;
+        for (int i = 0; i < ROUNDS; ++i) {
+            long allocsBegin = benchAllocs;
+            long begin = nowNS();
+            bench.func(n);
+            double ns = (double)(nowNS() - begin) / n;
+            if (i == 0 || ns < bestNS) bestNS = ns;
+            allocs = (double)(benchAllocs - allocsBegin) / n;
+        }
+
+        printf("%s\t%ld\t%.1f\t%.2f\n", bench.name, n, bestNS, allocs);
+        fflush(stdout);
+    }
+
+    return 0;
+}
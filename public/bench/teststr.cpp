@@ -0,0 +1,242 @@
+/**
+ * @file teststr.cpp
+ * @brief 字符串处理函数的对比测试程序，把向量化实现的结果与原来逐字节处理的实现逐一对比
+ * @author Sugar (hzzou@dhu.edu.cn)
+ * @date 2022-09-20
+ */
+
+#include "../_public.h"
+
+// 以下是向量化之前的实现，原样保留，函数名加了Old前缀，作为对比的标准
+
+void OldDeleteLChar(char* str, const char chr) {
+    if (str == 0) return;
+    if (strlen(str) == 0) return;
+
+    char strTemp[strlen(str) + 1];
+
+    int iTemp = 0;
+
+    memset(strTemp, 0, sizeof(strTemp));
+    strcpy(strTemp, str);
+
+    while (strTemp[iTemp] == chr) iTemp++;
+
+    memset(str, 0, strlen(str) + 1);
+
+    strcpy(str, strTemp + iTemp);
+}
+
+void OldDeleteRChar(char* str, const char chr) {
+    if (str == 0) return;
+    if (strlen(str) == 0) return;
+
+    int istrlen = strlen(str);
+
+    while (istrlen > 0) {
+        if (str[istrlen - 1] != chr) break;
+
+        str[istrlen - 1] = 0;
+
+        istrlen--;
+    }
+}
+
+void OldDeleteLRChar(char* str, const char chr) {
+    OldDeleteLChar(str, chr);
+    OldDeleteRChar(str, chr);
+}
+
+void OldToUpper(char* str) {
+    if (str == 0) return;
+
+    if (strlen(str) == 0) return;
+
+    int istrlen = strlen(str);
+
+    for (int ii = 0; ii < istrlen; ii++) {
+        if ((str[ii] >= 'a') && (str[ii] <= 'z')) str[ii] = str[ii] - 32;
+    }
+}
+
+void OldToLower(char* str) {
+    if (str == 0) return;
+
+    if (strlen(str) == 0) return;
+
+    int istrlen = strlen(str);
+
+    for (int ii = 0; ii < istrlen; ii++) {
+        if ((str[ii] >= 'A') && (str[ii] <= 'Z')) str[ii] = str[ii] + 32;
+    }
+}
+
+void OldUpdateStr(char* str, const char* str1, const char* str2, bool bloop) {
+    if (str == 0) return;
+    if (strlen(str) == 0) return;
+    if ((str1 == 0) || (str2 == 0)) return;
+
+    if ((bloop == true) && (strstr(str2, str1) != nullptr)) return;
+
+    int ilen = strlen(str) * 10;
+    if (ilen < 1000) ilen = 1000;
+
+    char strTemp[ilen];
+
+    char* strStart = str;
+
+    char* strPos = 0;
+
+    while (true) {
+        if (bloop == true) {
+            strPos = strstr(str, str1);
+        } else {
+            strPos = strstr(strStart, str1);
+        }
+
+        if (strPos == 0) break;
+
+        memset(strTemp, 0, sizeof(strTemp));
+        STRNCPY(strTemp, sizeof(strTemp), str, strPos - str);
+        STRCAT(strTemp, sizeof(strTemp), str2);
+        STRCAT(strTemp, sizeof(strTemp), strPos + strlen(str1));
+        strcpy(str, strTemp);
+
+        strStart = strPos + strlen(str2);
+    }
+}
+
+void OldPickNumber(const char* src, char* dest, const bool bsigned, const bool bdot) {
+    if (dest == 0) return;
+    if (src == 0) {
+        strcpy(dest, "");
+        return;
+    }
+
+    char strtemp[strlen(src) + 1];
+    memset(strtemp, 0, sizeof(strtemp));
+    strcpy(strtemp, src);
+    OldDeleteLRChar(strtemp, ' ');
+
+    int ipossrc, iposdst, ilen;
+    ipossrc = iposdst = ilen = 0;
+
+    ilen = strlen(strtemp);
+
+    for (ipossrc = 0; ipossrc < ilen; ipossrc++) {
+        if ((bsigned == true) && (strtemp[ipossrc] == '+')) {
+            dest[iposdst++] = strtemp[ipossrc];
+            continue;
+        }
+
+        if ((bsigned == true) && (strtemp[ipossrc] == '-')) {
+            dest[iposdst++] = strtemp[ipossrc];
+            continue;
+        }
+
+        if ((bdot == true) && (strtemp[ipossrc] == '.')) {
+            dest[iposdst++] = strtemp[ipossrc];
+            continue;
+        }
+
+        if (isdigit(strtemp[ipossrc])) dest[iposdst++] = strtemp[ipossrc];
+    }
+
+    dest[iposdst] = 0;
+}
+
+// 随机字符串的字符集，包括字母的边界字符、数字、符号、空格和非ASCII字符，空格和字母多一些
+const char CHARSET[] = "aabbzzAABBZZ@[`{09  +-.,x\x80\xc0\xff";
+
+// 生成长度为len的随机字符串，写入str中
+void randomStr(char* str, int len) {
+    for (int i = 0; i < len; ++i) str[i] = CHARSET[rand() % (sizeof(CHARSET) - 1)];
+    str[len] = 0;
+}
+
+int failCount = 0;   // 结果不同的次数
+
+// 比较新旧两种实现的结果，不同时输出用例
+void check(const char* name, const char* src, const char* expect, const char* actual) {
+    if (strcmp(expect, actual) == 0) return;
+    if (failCount++ < 10) printf("%s(\"%s\") 期望\"%s\"，实际\"%s\"\n", name, src, expect, actual);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 2) {
+        printf("Using: ./teststr [count]\n");
+        printf("Example: ./teststr 400000\n\n");
+        printf("把ToUpper、ToLower、DeleteLChar、DeleteRChar、UpdateStr、PickNumber的结果与向量化之前的实现对比，\n");
+        printf("count是随机用例的个数，缺省是400000，每个用例的字符串长度是0-130字节，起始地址随机对齐。\n");
+        printf("全部相同时返回0，否则输出不同的用例（最多10个）并返回1。\n\n");
+        return -1;
+    }
+
+    long count = (argc == 2) ? atol(argv[1]) : 400000;
+
+    srand(20220920);
+
+    // 目标缓冲区比源字符串大得多，UpdateStr替换后变长也不会溢出，起始地址加0-31字节的偏移，覆盖各种对齐
+    char src[201], expbuf[4096 + 32], actbuf[4096 + 32];
+    char str1[5], str2[5];
+
+    for (long i = 0; i < count; ++i) {
+        randomStr(src, rand() % 131);
+        char* expect = expbuf + rand() % 32;
+        char* actual = actbuf + rand() % 32;
+        char chr = CHARSET[rand() % (sizeof(CHARSET) - 1)];
+
+        strcpy(expect, src); strcpy(actual, src);
+        OldToUpper(expect); ToUpper(actual);
+        check("ToUpper", src, expect, actual);
+
+        strcpy(expect, src); strcpy(actual, src);
+        OldToLower(expect); ToLower(actual);
+        check("ToLower", src, expect, actual);
+
+        string strUpper = src;
+        ToUpper(strUpper);
+        strcpy(expect, src); OldToUpper(expect);
+        check("ToUpper(string)", src, expect, strUpper.c_str());
+
+        string strLower = src;
+        ToLower(strLower);
+        strcpy(expect, src); OldToLower(expect);
+        check("ToLower(string)", src, expect, strLower.c_str());
+
+        // 两端的字符多数情况下是要删除的字符，覆盖删除一部分和全部删除
+        if (rand() % 2 == 0) {
+            int len = strlen(src);
+            memset(src, chr, rand() % (len + 1));
+            int n = rand() % (len + 1);
+            memset(src + len - n, chr, n);
+        }
+        strcpy(expect, src); strcpy(actual, src);
+        OldDeleteLChar(expect, chr); DeleteLChar(actual, chr);
+        check("DeleteLChar", src, expect, actual);
+
+        strcpy(expect, src); strcpy(actual, src);
+        OldDeleteRChar(expect, chr); DeleteRChar(actual, chr);
+        check("DeleteRChar", src, expect, actual);
+
+        // str1从源字符串中截取，保证能找到，str2可以比str1短或长，也可以为空
+        int len1 = 1 + rand() % 3;
+        if ((int)strlen(src) >= len1) {
+            int pos = rand() % (strlen(src) - len1 + 1);
+            STRNCPY(str1, sizeof(str1), src + pos, len1);
+            randomStr(str2, rand() % 4);
+            bool bloop = (rand() % 2 == 0);
+            strcpy(expect, src); strcpy(actual, src);
+            OldUpdateStr(expect, str1, str2, bloop); UpdateStr(actual, str1, str2, bloop);
+            check(bloop ? "UpdateStr(bloop)" : "UpdateStr", src, expect, actual);
+        }
+
+        bool bsigned = (rand() % 2 == 0), bdot = (rand() % 2 == 0);
+        OldPickNumber(src, expect, bsigned, bdot); PickNumber(src, actual, bsigned, bdot);
+        check("PickNumber", src, expect, actual);
+    }
+
+    printf("用例%ld个，结果不同%d个\n", count, failCount);
+
+    return failCount == 0 ? 0 : 1;
+}
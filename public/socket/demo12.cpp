@@ -13,16 +13,16 @@ void ChldEXIT(int sig);  // 子进程退出函数。
 bool bsession=false;     // 客户端是否已登录：true-已登录;false-未登录或登录失败。
 
 // 处理业务的主函数。
-bool _main(const char *strrecvbuffer,char *strsendbuffer);
+bool _main(const char *strrecvbuffer,CStrBuilder &sendbuffer);
 
 // 登录业务处理函数。
-bool srv001(const char *strrecvbuffer,char *strsendbuffer);
+bool srv001(const char *strrecvbuffer,CStrBuilder &sendbuffer);
 
 // 查询余额业务处理函数。
-bool srv002(const char *strrecvbuffer,char *strsendbuffer);
+bool srv002(const char *strrecvbuffer,CStrBuilder &sendbuffer);
 
 // 转账。
-bool srv003(const char *strrecvbuffer,char *strsendbuffer);
+bool srv003(const char *strrecvbuffer,CStrBuilder &sendbuffer);
  
 int main(int argc,char *argv[])
 {
@@ -62,22 +62,23 @@ int main(int argc,char *argv[])
     TcpServer.CloseListen();
 
     // 子进程与客户端进行通讯，处理业务。
-    char strrecvbuffer[1024],strsendbuffer[1024];
+    char strrecvbuffer[1024];
+    CStrBuilder sendbuffer;     // 响应报文，用CStrBuilder生成，缓冲区自动扩容，不会截断。
 
     // 与客户端通讯，接收客户端发过来的报文后，回复ok。
     while (1)
     {
       memset(strrecvbuffer,0,sizeof(strrecvbuffer));
-      memset(strsendbuffer,0,sizeof(strsendbuffer));
+      sendbuffer.Clear();
 
       if (TcpServer.Read(strrecvbuffer)==false) break; // 接收客户端的请求报文。
       logfile.Write("接收：%s\n",strrecvbuffer);
 
       // 处理业务的主函数。
-      if (_main(strrecvbuffer,strsendbuffer)==false) break;
+      if (_main(strrecvbuffer,sendbuffer)==false) break;
 
-      if (TcpServer.Write(strsendbuffer)==false) break; // 向客户端发送响应结果。
-      logfile.Write("发送：%s\n",strsendbuffer);
+      if (TcpServer.Write(sendbuffer.c_str(),sendbuffer.Length())==false) break; // 向客户端发送响应结果。
+      logfile.Write("发送：%s\n",sendbuffer.c_str());
     }
 
     ChldEXIT(0);
@@ -113,7 +114,7 @@ void ChldEXIT(int sig)
 }
 
 // 处理业务的主函数。
-bool _main(const char *strrecvbuffer,char *strsendbuffer)
+bool _main(const char *strrecvbuffer,CStrBuilder &sendbuffer)
 {
   // 解析strrecvbuffer，获取服务代码（业务代码）。
   int isrvcode=-1;
@@ -121,18 +122,18 @@ bool _main(const char *strrecvbuffer,char *strsendbuffer)
 
   if ( (isrvcode!=1) && (bsession==false) )
   {
-    strcpy(strsendbuffer,"<retcode>-1</retcode><message>用户未登录。</message>"); return true;
+    sendbuffer.AddField("retcode",-1); sendbuffer.AddField("message","用户未登录。"); return true;
   }
 
   // 处理每种业务。
   switch (isrvcode)
   {
     case 1:   // 登录。
-      srv001(strrecvbuffer,strsendbuffer); break;
+      srv001(strrecvbuffer,sendbuffer); break;
     case 2:   // 查询余额。
-      srv002(strrecvbuffer,strsendbuffer); break;
+      srv002(strrecvbuffer,sendbuffer); break;
     case 3:   // 转账。
-      srv003(strrecvbuffer,strsendbuffer); break;
+      srv003(strrecvbuffer,sendbuffer); break;
     default:
       logfile.Write("业务代码不合法：%s\n",strrecvbuffer); return false;
   }
@@ -141,7 +142,7 @@ bool _main(const char *strrecvbuffer,char *strsendbuffer)
 }
 
 // 登录。
-bool srv001(const char *strrecvbuffer,char *strsendbuffer)
+bool srv001(const char *strrecvbuffer,CStrBuilder &sendbuffer)
 {
   // <srvcode>1</srvcode><tel>1392220000</tel><password>123456</password>
 
@@ -151,19 +152,21 @@ bool srv001(const char *strrecvbuffer,char *strsendbuffer)
   GetXMLBuffer(strrecvbuffer,"password",password,30);
 
   // 处理业务。
-  // 把处理结果生成strsendbuffer。
+  // 把处理结果生成sendbuffer。
   if ( (strcmp(tel,"1392220000")==0) && (strcmp(password,"123456")==0) )
   {
-    strcpy(strsendbuffer,"<retcode>0</retcode><message>成功。</message>");  bsession=true;
+    sendbuffer.AddField("retcode",0); sendbuffer.AddField("message","成功。");  bsession=true;
   }
   else
-    strcpy(strsendbuffer,"<retcode>-1</retcode><message>失败。</message>");
+  {
+    sendbuffer.AddField("retcode",-1); sendbuffer.AddField("message","失败。");
+  }
 
   return true;
 }
 
 // 查询余额业务处理函数。
-bool srv002(const char *strrecvbuffer,char *strsendbuffer)
+bool srv002(const char *strrecvbuffer,CStrBuilder &sendbuffer)
 {
   // <srvcode>2</srvcode><cardid>62620000000001</cardid>
 
@@ -172,21 +175,25 @@ bool srv002(const char *strrecvbuffer,char *strsendbuffer)
   GetXMLBuffer(strrecvbuffer,"cardid",cardid,30);
 
   // 处理业务。
-  // 把处理结果生成strsendbuffer。
+  // 把处理结果生成sendbuffer。
   if (strcmp(cardid,"62620000000001")==0) 
-    strcpy(strsendbuffer,"<retcode>0</retcode><message>成功。</message><ye>100.58</ye>");
+  {
+    sendbuffer.AddField("retcode",0); sendbuffer.AddField("message","成功。"); sendbuffer.AddField("ye",100.58);
+  }
   else
-    strcpy(strsendbuffer,"<retcode>-1</retcode><message>失败。</message>");
+  {
+    sendbuffer.AddField("retcode",-1); sendbuffer.AddField("message","失败。");
+  }
 
   return true;
 }
 
 // 转账。
-bool srv003(const char *strrecvbuffer,char *strsendbuffer)
+bool srv003(const char *strrecvbuffer,CStrBuilder &sendbuffer)
 {
   // 编写转账业务的代码。
 
-  strcpy(strsendbuffer,"<retcode>0</retcode><message>成功。</message><ye>100.58</ye>");
+  sendbuffer.AddField("retcode",0); sendbuffer.AddField("message","成功。"); sendbuffer.AddField("ye",100.58);
 
   return true;
 }
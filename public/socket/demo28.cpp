@@ -47,17 +47,15 @@ int main(int argc,char *argv[])
   printf("%s\n",strget);
 
   // 先把响应报文头部发送给客户端。
-  char strsend[102400];
-  memset(strsend,0,sizeof(strsend));
-  sprintf(strsend,\
-         "HTTP/1.1 200 OK\r\n"\
-         "Server: demo28\r\n"\
-         "Content-Type: text/html;charset=utf-8\r\n"\
-         "\r\n");
-         // "Content-Length: 108909\r\n\r\n");
-  if (Writen(TcpServer.m_connfd,strsend,strlen(strsend))== false) return -1;
-
-  //logfile.Write("%s",strsend);
+  CStrBuilder strsend(STRB_XML,256);
+  strsend.Append("HTTP/1.1 200 OK\r\n"\
+                 "Server: demo28\r\n"\
+                 "Content-Type: text/html;charset=utf-8\r\n"\
+                 "\r\n");
+                 // "Content-Length: 108909\r\n\r\n");
+  if (Writen(TcpServer.m_connfd,strsend.c_str(),strsend.Length())== false) return -1;
+
+  //logfile.Write("%s",strsend.c_str());
 
   // 解析GET请求中的参数，从T_ZHOBTMIND1表中查询数据，返回给客户端。
   SendData(TcpServer.m_connfd,strget);
@@ -112,18 +110,27 @@ bool SendData(const int sockfd,const char *strget)
  
   stmt.execute();   // 执行查询数据的SQL。
 
-  Writen(sockfd,"<data>\n",strlen("<data>\n"));      // 返回xml的头部标签。
+  // 响应报文先存放在CStrBuilder中，每满64K发送一次，不必每行调用一次Writen。
+  CStrBuilder strsend(STRB_XML,65536+1024);
+  strsend.Append("<data>\n");                     // 返回xml的头部标签。
 
   while (true)
   {
     memset(strxml,0,sizeof(strxml));
     if (stmt.next()!=0) break;
 
-    strcat(strxml,"\n");                           // 注意加上换行符。
-    Writen(sockfd,strxml,strlen(strxml));          // 返回xml的每一行。
+    strsend.Append(strxml);                        // 返回xml的每一行。
+    strsend.AppendChar('\n');                      // 注意加上换行符。
+
+    if (strsend.Length()>=65536)
+    {
+      if (Writen(sockfd,strsend.c_str(),strsend.Length())==false) return false;
+      strsend.ClearBuffer();
+    }
   }
 
-  Writen(sockfd,"</data>\n",strlen("</data>\n"));  // 返回xml的尾部标签。
+  strsend.Append("</data>\n");                    // 返回xml的尾部标签。
+  if (Writen(sockfd,strsend.c_str(),strsend.Length())==false) return false;
   
   return true;
 }
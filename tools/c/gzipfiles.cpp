@@ -12,21 +12,51 @@ void EXIT(int sig) {
     exit(0);
 }
 
+// 压缩目录中超时的文件，Dir是已打开的CDirScanner、CDirWalker或CDirSnapshot，三者获取文件信息的成员相同
+// 扫描时获取的文件信息可能已过时，超时的文件在处理之前用Refresh方法重新获取文件信息再确认一次
+template <typename T>
+void gzipFiles(T& Dir, const time_t timeOut) {
+    // 遍历目录中的文件名
+    char strCmd[1024];
+    CMatchRule gzRule("*.gz");  // 已压缩的文件不再压缩，规则只编译一次
+    while (true) {
+        // 得到每一个文件的信息，用ReadDir()方法
+        if (!Dir.ReadDir()) break;  // 读取失败则说明没有文件了
+        // 与超时的时间点比较，如果更早，则说明需要压缩
+        printf("Ful1FileName=%s\n",Dir.m_FullFileName);
+        if ((Dir.m_mtime < timeOut) && !gzRule.Match(Dir.m_FileName) && Dir.Refresh() && (Dir.m_mtime < timeOut)) {
+            // 压缩命令，调用系统的gzip命令
+            SNPRINTF(strCmd, sizeof(strCmd), 1000, "/usr/bin/gzip -f %s 1>/dev/null 2>/dev/null", Dir.m_FullFileName);
+            if (system(strCmd) == 0) {
+                printf("gzip %s OK\n", Dir.m_FullFileName);
+            } else {
+                printf("gzip %s failed\n", Dir.m_FullFileName);
+            }
+        }
+        
+    }
+}
+
 int main(int argc, char* argv[]) {
     // 程序的帮助
-    if (argc != 4) {
+    if (argc < 4 || argc > 6) {
         printf("\n");
-        printf("Using:./tools/bin/gzipfiles pathname matchstr timeout\n\n");
+        printf("Using:./tools/bin/gzipfiles pathname matchstr timeout [threads] [snapfile]\n\n");
 
         printf(R"(
 Example:/tools/bin/gzipfiles /log/idc "*.log.20*" 0.02
         /tools/bin/gzipfiles /tmp/idc/surfdata "*.xml,*.json" 0.01
+        /tools/bin/gzipfiles /data/archive "*.xml" 30 8
+        /tools/bin/gzipfiles /data/archive "*.xml" 30 1 /tmp/gzipfiles_archive.snap
         /tools/bin/procctl 300 /tools/bin/gzipfiles /log/idc "*.log.20*" 0.02
         /tools/bin/procctl 300 /tools/bin/gzipfiles /tmp/idc/surfdata "*.xml,*.json" 0.01
         )");
 
         printf("\n\n这是一个工具程序，用于压缩历史的数据文件或日志文件。\n");
         printf("本程序把pathname目录及子目录中timeout天之前的匹配matchstr文件全部压缩，timeout可以是小数。\n");
+        printf("threads是扫描子目录的线程数，可选参数，缺省为1，子目录很多时（例如按日期分区的归档目录）可以用多个线程。\n");
+        printf("snapfile是目录快照文件名，可选参数，指定后只重新扫描上次运行之后有变化的目录，threads参数不起作用，\n");
+        printf("文件很多、变化很少的目录（例如长期保存的归档目录）可以用快照文件，压缩之前会重新确认文件的修改时间。\n");
         printf("本程序不写日志文件，也不会在控制台输出任何信息。\n");
         printf("本程序调用/usr/bin/gzip命令压缩文件。\n\n\n");
         return -1;
@@ -37,33 +67,37 @@ Example:/tools/bin/gzipfiles /log/idc "*.log.20*" 0.02
     signal(SIGINT, EXIT);
     signal(SIGTERM, EXIT);
 
-    // 获取文件的超时的时间点
-    char strTimeOut[21];
-    LocalTime(strTimeOut, "yyyy-mm-dd hh24:mi:ss", 0 - static_cast<int>(stof(argv[3]) * 24 * 60 * 60));
+    // 获取文件的超时的时间点，直接与文件的修改时间比较，不必把每个文件的时间转换为字符串
+    time_t timeOut = time(0) - static_cast<int>(stof(argv[3]) * 24 * 60 * 60);
 
-    // 打开目录，CDir.OpenDir()
-    CDir Dir;
-    if (!Dir.OpenDir(argv[1], argv[2], 10000, true)) {
-        printf("Dir.OpenDir(%s) failed\n", argv[1]);
-        return -1;
-    }
-    // 遍历目录中的文件名
-    char strCmd[1024];
-    while (true) {
-        // 得到每一个文件的信息，用CDir.ReadDir()方法
-        if (!Dir.ReadDir()) break;  // 读取失败则说明没有文件了
-        // 与超时的时间点比较，如果更早，则说明需要压缩
-        printf("Ful1FileName=%s\n",Dir.m_FullFileName);
-        if ((strcmp(Dir.m_ModifyTime, strTimeOut) < 0) && !MatchStr(Dir.m_FileName, "*.gz")) {
-            // 压缩命令，调用系统的gzip命令
-            SNPRINTF(strCmd, sizeof(strCmd), 1000, "/usr/bin/gzip -f %s 1>/dev/null 2>/dev/null", Dir.m_FullFileName);
-            if (system(strCmd) == 0) {
-                printf("gzip %s OK\n", Dir.m_FullFileName);
-            } else {
-                printf("gzip %s failed\n", Dir.m_FullFileName);
-            }
+    CMatchRule MatchRule(argv[2]);  // 匹配文件名的规则只编译一次
+    int threads = (argc >= 5) ? atoi(argv[4]) : 1;
+
+    if (argc == 6) {
+        // 用快照文件增量扫描，处理完后保存快照，被压缩的文件所在的目录下次会重新扫描
+        CDirSnapshot Dir;
+        if (!Dir.OpenDir(argv[1], argv[2], argv[5])) {
+            printf("Dir.OpenDir(%s) failed\n", argv[1]);
+            return -1;
         }
-        
+        gzipFiles(Dir, timeOut);
+        if (!Dir.SaveSnapshot()) printf("Dir.SaveSnapshot(%s) failed\n", argv[5]);
+    } else if (threads > 1) {
+        // 子目录很多时用多个线程扫描，全部扫描完后再逐个处理
+        CDirWalker Dir;
+        if (!Dir.OpenDir(argv[1], MatchRule, threads)) {
+            printf("Dir.OpenDir(%s) failed\n", argv[1]);
+            return -1;
+        }
+        gzipFiles(Dir, timeOut);
+    } else {
+        // 打开目录，用CDirScanner逐个获取文件，不限制文件的数量
+        CDirScanner Dir;
+        if (!Dir.OpenDir(argv[1], MatchRule, true)) {
+            printf("Dir.OpenDir(%s) failed\n", argv[1]);
+            return -1;
+        }
+        gzipFiles(Dir, timeOut);
     }
 
 